@@ -0,0 +1,236 @@
+/*
+ * segaSlider frame parser fuzzing and recovery benchmark
+ *
+ *   parser_fuzz [frames] [seed]
+ *
+ * builds a stream of host -> board frames like a game would send (mostly LED frames, with some
+ * scan/detect/boardinfo and unknown commands), corrupts it at a few byte error rates
+ * (bit flips, replaced, dropped and inserted bytes) and feeds it through getPacket, then reports:
+ *   - frames received intact, lost, rejected by checksum, and wrongly accepted (corrupt but passed the checksum)
+ *   - recovery: wire bytes from each corruption until the parser next returns an intact frame
+ *   - parse throughput (MB/s of wire data and frames/s)
+ *
+ * every intact frame after a corruption should be received, so recovery should never be much more than
+ * the corrupted frame plus the next one (see SLIDER_CHECK_FRAMES in segaSlider.h)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "segaSlider.h"
+
+// most frames a received packet can be past the last one matched, before it's counted as a false accept
+#define MAX_FRAME_SKIP 256
+
+static volatile unsigned long sink;
+
+struct frameInfo {
+  byte command;
+  std::vector<byte> data;
+};
+
+// escape and append a frame (segaSlider::sendPacket only handles board-sized packets)
+static void appendFrame(std::vector<byte> &out, const frameInfo &frame) {
+  byte checksum = 0;
+  checksum -= SLIDER_FRAMING_START;
+
+  auto put = [&](byte b) {
+    checksum -= b;
+    if (b == SLIDER_FRAMING_START || b == SLIDER_FRAMING_ESCAPE) {
+      out.push_back(SLIDER_FRAMING_ESCAPE);
+      out.push_back(b - 1);
+    }
+    else {
+      out.push_back(b);
+    }
+  };
+
+  out.push_back(SLIDER_FRAMING_START);
+  put(frame.command);
+  put(frame.data.size());
+  for (byte b : frame.data)
+    put(b);
+  put(checksum);
+}
+
+// a random frame, in roughly the mix a game sends
+static frameInfo randomFrame(std::mt19937 &rng) {
+  frameInfo frame;
+  unsigned kind = rng() % 100;
+
+  if (kind < 70) {
+    frame.command = SLIDER_LED;
+    frame.data.resize(SLIDER_LED_MAX_DATA);
+    frame.data[0] = 0x3F;
+    for (size_t i = 1; i < frame.data.size(); i++)
+      frame.data[i] = rng();
+  }
+  else if (kind < 80) {
+    frame.command = (kind & 1) ? SLIDER_SCAN_ON : SLIDER_SCAN_OFF;
+  }
+  else if (kind < 90) {
+    frame.command = (kind & 1) ? SLIDER_DETECT : SLIDER_BOARDINFO;
+  }
+  else {
+    frame.command = SLIDER_UNKNOWN_09;
+    frame.data.resize(2 + rng() % 7);
+    for (byte &b : frame.data)
+      b = rng();
+  }
+
+  return frame;
+}
+
+// copy `in` with random errors at `rate` per byte
+// positions (in the output) of each error are added to errorPos
+static std::vector<byte> corrupt(const std::vector<byte> &in, double rate, std::mt19937 &rng, std::vector<size_t> &errorPos) {
+  std::vector<byte> out;
+  out.reserve(in.size() + in.size() / 64);
+  std::uniform_real_distribution<double> chance(0, 1);
+
+  for (byte b : in) {
+    if (rate <= 0 || chance(rng) >= rate) {
+      out.push_back(b);
+      continue;
+    }
+
+    errorPos.push_back(out.size());
+    switch (rng() % 4) {
+      case 0: out.push_back(b ^ (1 << (rng() % 8))); break; // bit flip
+      case 1: out.push_back(rng()); break; // replaced
+      case 2: break; // dropped
+      case 3: out.push_back(rng()); out.push_back(b); break; // inserted before
+    }
+  }
+
+  return out;
+}
+
+// nearest-rank percentile of sorted values
+static size_t percentile(const std::vector<size_t> &sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  return sorted[(size_t)(p / 100.0 * (sorted.size() - 1) + 0.5)];
+}
+
+// positions of every frame with the same data, keyed by the data followed by the command
+typedef std::unordered_map<std::string, std::vector<size_t>> frameIndexMap;
+
+static void runRate(const std::vector<frameInfo> &frames, const frameIndexMap &frameIndex,
+                    const std::vector<byte> &clean, double rate, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::vector<size_t> errorPos;
+  std::vector<byte> wireData = corrupt(clean, rate, rng, errorPos);
+
+  // time a plain parse first (matching packets to frames below is much slower than parsing)
+  double sec;
+  {
+    segaSlider<sliderMemoryTransport> slider;
+    slider.getTransport().setInput(wireData.data(), wireData.size());
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned long packets = 0;
+    while (slider.getTransport().available())
+      packets += slider.getPacket().IsValid;
+    auto end = std::chrono::steady_clock::now();
+
+    sec = std::chrono::duration<double>(end - start).count();
+    sink = packets;
+  }
+
+  segaSlider<sliderMemoryTransport> slider;
+  slider.getTransport().setInput(wireData.data(), wireData.size());
+
+  unsigned long received = 0, lost = 0, invalid = 0, falseAccepts = 0;
+  size_t nextFrame = 0;
+  size_t nextError = 0; // first error not recovered from yet
+  std::vector<size_t> recovery;
+
+  while (true) {
+    sliderPacket pkt = slider.getPacket();
+    if (pkt.Command == (sliderCommand)0) {
+      if (!slider.getTransport().available())
+        break;
+      continue; // a frame with command 0 (if the parser returns those)
+    }
+
+    if (!pkt.IsValid) {
+      invalid++;
+      continue;
+    }
+
+    // find the frame this was (errors can skip some, but a corrupt packet that passed the checksum
+    // could also look like a short frame from much later on, so don't search too far)
+    std::string key((const char*)pkt.Data, pkt.DataLength);
+    key.push_back(pkt.Command);
+    auto found = frameIndex.find(key);
+    if (found == frameIndex.end()) {
+      falseAccepts++;
+      continue;
+    }
+    auto next = std::lower_bound(found->second.begin(), found->second.end(), nextFrame);
+    if (next == found->second.end() || *next - nextFrame > MAX_FRAME_SKIP) {
+      falseAccepts++;
+      continue;
+    }
+    size_t match = *next;
+
+    lost += match - nextFrame;
+    received++;
+    nextFrame = match + 1;
+
+    // the parser is back in sync for every error before this frame's end
+    size_t endPos = wireData.size() - slider.getTransport().inputRemaining();
+    for (; nextError < errorPos.size() && errorPos[nextError] < endPos; nextError++)
+      recovery.push_back(endPos - errorPos[nextError]);
+  }
+  lost += frames.size() - nextFrame;
+
+  std::sort(recovery.begin(), recovery.end());
+
+  printf("error rate %-8g %7zu errors  %7lu ok %6lu lost %6lu bad sum %4lu false ok %6lu dropped",
+         rate, errorPos.size(), received, lost, invalid, falseAccepts, slider.getDroppedFrames());
+  if (!recovery.empty())
+    printf("  recovery p50 %4zu p99 %4zu max %4zu B", percentile(recovery, 50), percentile(recovery, 99), recovery.back());
+  printf("  %7.1f MB/s %9.0f frames/s\n", wireData.size() / sec / 1e6, frames.size() / sec);
+}
+
+int main(int argc, char** argv) {
+  unsigned long numFrames = 200000;
+  unsigned seed = 1234;
+  if (argc > 1)
+    numFrames = strtoul(argv[1], NULL, 0);
+  if (argc > 2)
+    seed = strtoul(argv[2], NULL, 0);
+
+  std::mt19937 rng(seed);
+  std::vector<frameInfo> frames;
+  std::vector<byte> clean;
+  frameIndexMap frameIndex;
+  size_t maxFrameBytes = 0;
+  for (unsigned long i = 0; i < numFrames; i++) {
+    frames.push_back(randomFrame(rng));
+
+    std::string key(frames.back().data.begin(), frames.back().data.end());
+    key.push_back(frames.back().command);
+    frameIndex[key].push_back(i);
+
+    size_t before = clean.size();
+    appendFrame(clean, frames.back());
+    maxFrameBytes = std::max(maxFrameBytes, clean.size() - before);
+  }
+
+  printf("segaSlider parser fuzz (%lu frames, %zu wire bytes, largest frame %zu B, seed %u)\n\n",
+         numFrames, clean.size(), maxFrameBytes, seed);
+
+  const double rates[] = { 0, 1e-5, 1e-4, 1e-3, 1e-2 };
+  for (double rate : rates)
+    runRate(frames, frameIndex, clean, rate, seed + 1);
+
+  return 0;
+}
@@ -0,0 +1,252 @@
+/*
+ * segaSlider protocol micro-benchmarks
+ *
+ * builds segaSlider.cpp unmodified against the host Arduino shim and reports
+ * packets/sec and ns/byte (wire bytes) for encode, decode and checksum paths
+ * the main numbers use the firmware's transport and codec (sliderSerialTransport, binary),
+ * with a few more for the text codec and the in-memory transport
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+
+#include "segaSlider.h"
+#include "sliderdefs.h"
+
+
+static volatile unsigned long sink;
+
+// the firmware's protocol type
+typedef segaSlider<sliderSerialTransport> firmwareSlider;
+
+struct benchResult {
+  double nsPerPacket;
+  double nsPerByte;
+};
+
+// run fn `iterations` times and report the results
+// wireBytes is the number of bytes on the wire for a single packet
+template <typename F>
+static benchResult runBench(const char* name, unsigned long iterations, size_t wireBytes, F fn) {
+  // warm up caches and the allocator
+  for (unsigned long i = 0; i < iterations / 10 + 1; i++)
+    fn();
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iterations; i++)
+    fn();
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  benchResult res;
+  res.nsPerPacket = ns / iterations;
+  res.nsPerByte = res.nsPerPacket / wireBytes;
+
+  printf("%-34s %12.0f pkt/s %10.1f ns/pkt %8.2f ns/byte %6zu B/pkt\n",
+         name, 1e9 / res.nsPerPacket, res.nsPerPacket, res.nsPerByte, wireBytes);
+  return res;
+}
+
+
+// build a slider LED frame: brightness byte followed by 32 BRG triplets
+static void fillLedFrame(byte* buf, byte fill) {
+  buf[0] = 0x3f;
+  for (int i = 1; i < 97; i++)
+    buf[i] = (fill != 0) ? fill : (byte)(i * 37);
+}
+
+// the original byte-at-a-time encoder (before sendPacket built whole frames)
+// kept as a reference point for the sendPacket numbers, and to encode frames larger than
+// SLIDER_SERIAL_SEND_MAX_DATA for the receive benchmarks
+static byte legacySendEscapedByte(HostSerial& serial, byte data, bool& sendError) {
+  if (data == SLIDER_FRAMING_ESCAPE || data == SLIDER_FRAMING_START) {
+    if (serial.availableForWrite() >= 2) {
+      sendError |= (serial.write((uint8_t)SLIDER_FRAMING_ESCAPE) != 1);
+      sendError |= (serial.write((uint8_t)(data - 0x1)) != 1);
+    }
+  }
+  else {
+    if (serial.availableForWrite() >= 1)
+      sendError |= (serial.write((uint8_t)data) != 1);
+  }
+  return 0 - data;
+}
+
+static bool legacySendPacket(HostSerial& serial, const sliderPacket& packet) {
+  if (serial.availableForWrite() < packet.DataLength + 4)
+    return false;
+
+  bool sendError = false;
+  byte checksum = 0;
+
+  serial.write((uint8_t)SLIDER_FRAMING_START);
+  checksum -= SLIDER_FRAMING_START;
+  checksum += legacySendEscapedByte(serial, (byte)packet.Command, sendError);
+  checksum += legacySendEscapedByte(serial, packet.DataLength, sendError);
+  for (byte i = 0; i < packet.DataLength; i++)
+    checksum += legacySendEscapedByte(serial, packet.Data[i], sendError);
+  legacySendEscapedByte(serial, checksum, sendError);
+
+  return !sendError;
+}
+
+// encode a packet into wire bytes
+static std::vector<uint8_t> encodePacket(const sliderPacket& pkt) {
+  HostSerial wire;
+  wire.txCapacity = 4096; // the legacy encoder needs room for the whole frame, and LED frames are longer than a CDC bank
+  legacySendPacket(wire, pkt);
+  return wire.tx;
+}
+
+
+static void benchSend(const char* name, const sliderPacket& pkt, unsigned long iterations) {
+  HostSerial wire;
+  firmwareSlider slider(&wire);
+
+  size_t wireBytes = encodePacket(pkt).size();
+  unsigned long calls = 0;
+  bool ok = true;
+
+  runBench(name, iterations, wireBytes, [&]() {
+    wire.tx.clear();
+    wire.writeCalls = 0;
+    ok &= slider.sendPacket(pkt);
+    calls = wire.writeCalls;
+  });
+  printf("%-34s %12lu write calls/pkt%s\n", "", calls, ok ? "" : " (SEND FAILED)");
+
+  std::string legacyName = std::string(name) + " [legacy]";
+  runBench(legacyName.c_str(), iterations, wireBytes, [&]() {
+    wire.tx.clear();
+    wire.writeCalls = 0;
+    sink = legacySendPacket(wire, pkt);
+    calls = wire.writeCalls;
+  });
+  printf("%-34s %12lu write calls/pkt\n", "", calls);
+}
+
+static void benchReceive(const char* name, const sliderPacket& pkt, unsigned long iterations) {
+  HostSerial wire;
+  firmwareSlider slider(&wire);
+
+  std::vector<uint8_t> frame = encodePacket(pkt);
+  uint64_t clockBefore = hostClock::nowMicros;
+  unsigned long valid = 0;
+
+  runBench(name, iterations, frame.size(), [&]() {
+    wire.rx.clear();
+    wire.rxPos = 0;
+    wire.feed(frame.data(), frame.size());
+
+    sliderPacket res = slider.getPacket();
+    valid += res.IsValid;
+  });
+
+  // virtual time spent in getPacket shows how long the firmware would block on-device
+  double virtualUs = (double)(hostClock::nowMicros - clockBefore) / (iterations + iterations / 10 + 1);
+  printf("%-34s %12.1f virtual us/pkt, %lu/%lu valid\n", "",
+         virtualUs, valid, iterations + iterations / 10 + 1);
+}
+
+// send and receive with the text codec (each frame is decoded again to check it)
+static void benchText(const char* name, const sliderPacket& pkt, unsigned long iterations) {
+  HostSerial wire;
+  segaSlider<sliderSerialTransport, sliderTextCodec> slider(&wire);
+
+  slider.sendPacket(pkt);
+  std::vector<uint8_t> text = wire.tx;
+
+  std::string sendName = std::string(name) + " send";
+  runBench(sendName.c_str(), iterations, text.size(), [&]() {
+    wire.tx.clear();
+    sink = slider.sendPacket(pkt);
+  });
+
+  unsigned long valid = 0;
+  std::string receiveName = std::string(name) + " receive";
+  runBench(receiveName.c_str(), iterations, text.size(), [&]() {
+    wire.rx.clear();
+    wire.rxPos = 0;
+    wire.feed(text.data(), text.size());
+    valid += slider.getPacket().IsValid;
+  });
+  printf("%-34s %12lu/%lu valid\n", "", valid, iterations + iterations / 10 + 1);
+}
+
+// receive through sliderMemoryTransport, which has no virtual calls or virtual time
+static void benchMemoryReceive(const char* name, const sliderPacket& pkt, unsigned long iterations) {
+  segaSlider<sliderMemoryTransport> slider;
+  std::vector<uint8_t> frame = encodePacket(pkt);
+  unsigned long valid = 0;
+
+  runBench(name, iterations, frame.size(), [&]() {
+    slider.getTransport().setInput(frame.data(), frame.size());
+    valid += slider.getPacket().IsValid;
+  });
+  printf("%-34s %12lu/%lu valid\n", "", valid, iterations + iterations / 10 + 1);
+}
+
+
+int main(int argc, char** argv) {
+  unsigned long iterations = 200000;
+  if (argc > 1)
+    iterations = strtoul(argv[1], NULL, 0);
+
+  byte scanData[32] = {};
+  byte scanDataFD[32];
+  byte scanDataFF[32];
+  memset(scanDataFD, SLIDER_FRAMING_ESCAPE, sizeof(scanDataFD));
+  memset(scanDataFF, SLIDER_FRAMING_START, sizeof(scanDataFF));
+  byte ledData[97];
+  byte ledDataFD[97];
+  byte ledDataFF[97];
+  fillLedFrame(ledData, 0);
+  fillLedFrame(ledDataFD, SLIDER_FRAMING_ESCAPE);
+  fillLedFrame(ledDataFF, SLIDER_FRAMING_START);
+
+  boardInfo info;
+  memcpy(info.model, divaSlider.model, sizeof(boardInfo::model));
+  memcpy(info.chipNumber, divaSlider.chipNumber, sizeof(boardInfo::chipNumber));
+
+  sliderPacket scanPkt = { SLIDER_SCAN_REPORT, scanData, 32, true };
+  sliderPacket scanPktFD = { SLIDER_SCAN_REPORT, scanDataFD, 32, true };
+  sliderPacket scanPktFF = { SLIDER_SCAN_REPORT, scanDataFF, 32, true };
+  sliderPacket boardinfoPkt = { SLIDER_BOARDINFO, (byte*)&info, sizeof(boardInfo), true };
+  sliderPacket scanOnPkt = { SLIDER_SCAN_ON, NULL, 0, true };
+  sliderPacket ledPkt = { SLIDER_LED, ledData, 97, true };
+  sliderPacket ledPktFD = { SLIDER_LED, ledDataFD, 97, true };
+  sliderPacket ledPktFF = { SLIDER_LED, ledDataFF, 97, true };
+
+  printf("segaSlider protocol benchmark (%lu iterations)\n\n", iterations);
+
+  printf("sendPacket\n");
+  benchSend("scan report (32 x 0x00)", scanPkt, iterations);
+  benchSend("scan report (32 x 0xFD)", scanPktFD, iterations);
+  benchSend("scan report (32 x 0xFF)", scanPktFF, iterations);
+  benchSend("boardinfo", boardinfoPkt, iterations);
+
+  printf("\ngetPacket\n");
+  benchReceive("scan on", scanOnPkt, iterations / 10);
+  benchReceive("led frame (mixed)", ledPkt, iterations / 10);
+  benchReceive("led frame (all 0xFD)", ledPktFD, iterations / 10);
+  benchReceive("led frame (all 0xFF)", ledPktFF, iterations / 10);
+
+  printf("\ntext codec\n");
+  benchText("scan report (32 x 0x00)", scanPkt, iterations / 10);
+  benchText("scan report (32 x 0xFF)", scanPktFF, iterations / 10);
+
+  printf("\ngetPacket, in-memory transport\n");
+  benchMemoryReceive("scan on", scanOnPkt, iterations / 10);
+  benchMemoryReceive("led frame (mixed)", ledPkt, iterations / 10);
+
+  printf("\ncheckPacketSum\n");
+  {
+    std::vector<uint8_t> frame = encodePacket(ledPkt);
+    runBench("led frame (mixed)", iterations, 97, [&]() {
+      sink = sliderCheckPacketSum(ledPkt, frame.back());
+    });
+  }
+
+  return 0;
+}
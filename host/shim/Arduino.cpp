@@ -0,0 +1,179 @@
+#include "Arduino.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace hostClock {
+  uint64_t nowMicros = 0;
+  uint32_t autoTickMicros = 1;
+  bool realTime = false;
+
+  static uint64_t realStartMicros;
+
+  static uint64_t monotonicMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+
+  // current time, ticking the virtual clock
+  static uint64_t now() {
+    if (realTime)
+      return monotonicMicros() - realStartMicros;
+    
+    nowMicros += autoTickMicros;
+    return nowMicros;
+  }
+
+  void startRealTime() {
+    realStartMicros = monotonicMicros();
+    realTime = true;
+  }
+
+  void spend(uint32_t us) {
+    if (realTime) {
+      uint64_t end = monotonicMicros() + us;
+      while (monotonicMicros() < end) {}
+    }
+    else {
+      nowMicros += us;
+    }
+  }
+}
+
+unsigned long micros() {
+  return (unsigned long)hostClock::now();
+}
+
+unsigned long millis() {
+  return (unsigned long)(hostClock::now() / 1000);
+}
+
+void delay(unsigned long ms) {
+  hostClock::spend(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  hostClock::spend(us);
+}
+
+
+namespace hostPins {
+  uint8_t modes[NUM_DIGITAL_PINS];
+  uint8_t levels[NUM_DIGITAL_PINS];
+  uint8_t inputLevels[NUM_DIGITAL_PINS] = {
+    HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH,
+    HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH,
+  };
+  int (*readHook)(uint8_t pin) = NULL;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < NUM_DIGITAL_PINS)
+    hostPins::modes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < NUM_DIGITAL_PINS)
+    hostPins::levels[pin] = val ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin >= NUM_DIGITAL_PINS)
+    return LOW;
+
+  if (hostPins::readHook) {
+    int level = hostPins::readHook(pin);
+    if (level >= 0)
+      return level;
+  }
+
+  if (hostPins::modes[pin] == OUTPUT)
+    return hostPins::levels[pin];
+  return hostPins::inputLevels[pin];
+}
+
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (write(*buffer++)) n++;
+    else break;
+  }
+  return n;
+}
+
+
+HostSerial Serial;
+
+void HostSerial::feed(const uint8_t* data, size_t len) {
+  // compact consumed data so repeated feeds don't grow forever
+  if (rxPos > 0 && rxPos == rx.size()) {
+    rx.clear();
+    rxPos = 0;
+  }
+  rx.insert(rx.end(), data, data + len);
+}
+
+void HostSerial::attachFd(int newFd) {
+  fd = newFd;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  clear();
+}
+
+void HostSerial::clear() {
+  rx.clear();
+  rxPos = 0;
+  tx.clear();
+  writeCalls = 0;
+}
+
+int HostSerial::available() {
+  if (fd >= 0 && rxPos == rx.size()) {
+    // everything buffered was read, so top up from fd
+    uint8_t buf[256];
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    rx.clear();
+    rxPos = 0;
+    if (n > 0)
+      rx.insert(rx.end(), buf, buf + n);
+  }
+  return (int)(rx.size() - rxPos);
+}
+
+int HostSerial::read() {
+  if (rxPos >= rx.size() && available() == 0)
+    return -1;
+  return rx[rxPos++];
+}
+
+int HostSerial::peek() {
+  if (rxPos >= rx.size() && available() == 0)
+    return -1;
+  return rx[rxPos];
+}
+
+size_t HostSerial::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+size_t HostSerial::write(const uint8_t* buffer, size_t size) {
+  writeCalls++;
+
+  if (fd >= 0) {
+    // a pty only fills up if nothing's reading it, so just wait for space
+    size_t done = 0;
+    while (done < size) {
+      ssize_t n = ::write(fd, buffer + done, size - done);
+      if (n > 0)
+        done += n;
+      else if (n < 0 && errno != EAGAIN && errno != EINTR)
+        break;
+    }
+    return done;
+  }
+
+  tx.insert(tx.end(), buffer, buffer + size);
+  return size;
+}
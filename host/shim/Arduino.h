@@ -0,0 +1,170 @@
+/*
+ * minimal Arduino core shim for building SlidA sources on a Linux host
+ *
+ * only covers what the sketch actually uses:
+ *   - a virtual microsecond clock (micros/millis/delay)
+ *   - Print/Stream with an in-memory `HostSerial` standing in for `Serial`
+ *   - digital pins (inputs read as HIGH unless set or overridden by a simulated device)
+ *
+ * the clock advances by `hostClock::autoTickMicros` on every micros()/millis() call,
+ * so firmware code that busy-waits on the clock still terminates
+ *
+ * for running the whole firmware against real tools (see hostMain.cpp), the clock can
+ * follow real time instead and `Serial` can be attached to a file descriptor (eg. a pty)
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define LED_BUILTIN 13
+#define NUM_DIGITAL_PINS 32
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+
+// Arduino.h defines these as macros, which would break the std headers used on the host
+template <typename T> inline T min(T a, T b) { return (a < b) ? a : b; }
+template <typename T> inline T max(T a, T b) { return (a > b) ? a : b; }
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_ptr(addr) (*(void* const*)(addr))
+#define memcpy_P memcpy
+
+
+// virtual clock
+namespace hostClock {
+  // current virtual time
+  extern uint64_t nowMicros;
+
+  // amount the clock advances on each micros()/millis() call
+  extern uint32_t autoTickMicros;
+
+  inline void advance(uint32_t us) { nowMicros += us; }
+
+  // follow the real (monotonic) clock instead, starting from 0 when this is set
+  extern bool realTime;
+  void startRealTime();
+
+  // simulate time spent by hardware (LED strip, I2C bus, ...)
+  // busy-waits in real time mode, otherwise just advances the virtual clock
+  void spend(uint32_t us);
+}
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+
+// digital pins
+namespace hostPins {
+  // current mode and output level of each pin
+  extern uint8_t modes[NUM_DIGITAL_PINS];
+  extern uint8_t levels[NUM_DIGITAL_PINS];
+
+  // level read from input pins (HIGH by default, like a pullup with nothing connected)
+  extern uint8_t inputLevels[NUM_DIGITAL_PINS];
+
+  // optional override for reading a pin (eg. a simulated IRQ line), return -1 to use inputLevels
+  extern int (*readHook)(uint8_t pin);
+}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+// direct port access: every pin is its own port here, with the input level in bit 0
+// (readHook isn't applied, so don't use this for the IRQ line)
+#define digitalPinToPort(pin) (pin)
+#define digitalPinToBitMask(pin) 1
+#define portInputRegister(port) ((volatile uint8_t*)&hostPins::inputLevels[port])
+
+
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t data) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+
+  size_t write(const char* str) {
+    if (str == NULL) return 0;
+    return write((const uint8_t*)str, strlen(str));
+  }
+  size_t write(const char* buffer, size_t size) {
+    return write((const uint8_t*)buffer, size);
+  }
+
+  virtual int availableForWrite() { return 0; }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { (void)timeout; }
+};
+
+
+// in-memory serial port
+// rx data is queued with `feed`, everything written ends up in `tx`
+// (or with `attachFd`, data is read from and written to a file descriptor instead)
+class HostSerial : public Stream {
+public:
+  // file descriptor used instead of rx/tx (-1 for none)
+  int fd = -1;
+
+  std::vector<uint8_t> rx;
+  size_t rxPos = 0;
+
+  std::vector<uint8_t> tx;
+
+  // value returned by availableForWrite
+  // (an empty CDC bank on a 32u4, which is the most it ever reports, so writes that couldn't fit on a board fail here too)
+  int txCapacity = 64;
+
+  // number of write calls made, each is roughly one USB transaction on a real board
+  unsigned long writeCalls = 0;
+
+  void begin(unsigned long baud) { (void)baud; }
+  explicit operator bool() { return true; }
+
+  // queue bytes for the firmware to read
+  void feed(const uint8_t* data, size_t len);
+
+  // drop all rx/tx data and counters
+  void clear();
+
+  // read from and write to fd instead of the in-memory buffers (fd is made non-blocking)
+  void attachFd(int newFd);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+
+  int availableForWrite() override { return txCapacity; }
+};
+
+extern HostSerial Serial;
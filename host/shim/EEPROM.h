@@ -0,0 +1,35 @@
+/*
+ * EEPROM shim -- 1KB (ATmega32u4 size) in memory, erased (0xFF) at startup
+ */
+
+#pragma once
+#include <Arduino.h>
+
+class EEPROMClass {
+public:
+  uint8_t data[1024];
+
+  // writes since boot, so tools can check settings aren't rewritten needlessly
+  unsigned long writes = 0;
+
+  EEPROMClass() { memset(data, 0xFF, sizeof(data)); }
+
+  uint8_t read(int idx) { return data[idx]; }
+  void write(int idx, uint8_t val) { data[idx] = val; writes++; }
+  void update(int idx, uint8_t val) { if (data[idx] != val) write(idx, val); }
+  uint16_t length() { return sizeof(data); }
+
+  template <typename T> T &get(int idx, T &t) {
+    memcpy(&t, &data[idx], sizeof(T));
+    return t;
+  }
+
+  template <typename T> const T &put(int idx, const T &t) {
+    const uint8_t* bytes = (const uint8_t*)&t;
+    for (size_t i = 0; i < sizeof(T); i++)
+      update(idx + i, bytes[i]);
+    return t;
+  }
+};
+
+extern EEPROMClass EEPROM;
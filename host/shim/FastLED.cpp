@@ -0,0 +1,34 @@
+#include "FastLED.h"
+
+CFastLED FastLED;
+
+namespace hostLeds {
+  void (*onShow)() = NULL;
+}
+
+void CFastLED::show() {
+  // 24 bits at 800kHz per LED, then at least 50us low to latch
+  hostClock::spend(30 * numLeds + 50);
+
+  if (hostLeds::onShow)
+    hostLeds::onShow();
+}
+
+uint8_t calculate_max_brightness_for_power_mW(const CRGB* leds, uint16_t numLeds, uint8_t targetBrightness, uint32_t maxPower_mW) {
+  // mW per channel at full value, and per LED when dark
+  const uint32_t red_mW = 16 * 5;
+  const uint32_t green_mW = 11 * 5;
+  const uint32_t blue_mW = 15 * 5;
+  const uint32_t dark_mW = 1 * 5;
+
+  uint32_t total_mW = 0;
+  for (uint16_t i = 0; i < numLeds; i++)
+    total_mW += leds[i].r * red_mW + leds[i].g * green_mW + leds[i].b * blue_mW;
+  total_mW = (total_mW >> 8) + numLeds * dark_mW;
+
+  uint32_t requested_mW = (total_mW * targetBrightness) / 256;
+  if (requested_mW <= maxPower_mW)
+    return targetBrightness;
+
+  return (targetBrightness * maxPower_mW) / requested_mW;
+}
@@ -0,0 +1,68 @@
+/*
+ * FastLED shim -- CRGB and the CFastLED calls SlidA uses
+ *
+ * show() takes as long as a WS2812 update would (30us per LED plus the reset time) and then
+ * calls hostLeds::onShow, so tools can see exactly when each frame would have hit the strip
+ */
+
+#pragma once
+#include <Arduino.h>
+
+struct CRGB {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+
+  enum HTMLColorCode {
+    Black = 0x000000,
+    White = 0xFFFFFF,
+    Red = 0xFF0000,
+    Green = 0x008000,
+    Blue = 0x0000FF,
+    Teal = 0x008080,
+  };
+
+  CRGB() {}
+  CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+  CRGB(uint32_t colorcode) : r(colorcode >> 16), g(colorcode >> 8), b(colorcode) {}
+  CRGB(HTMLColorCode colorcode) : CRGB((uint32_t)colorcode) {}
+
+  bool operator==(const CRGB &other) const { return r == other.r && g == other.g && b == other.b; }
+  bool operator!=(const CRGB &other) const { return !(*this == other); }
+};
+
+// chipsets and colour orders are only used as template arguments
+enum ESPIChipsets { WS2812B, WS2812, SK6812 };
+enum EOrder { RGB, RBG, GRB, GBR, BRG, BGR };
+
+class CFastLED {
+private:
+  CRGB* leds = NULL;
+  int numLeds = 0;
+  uint8_t brightness = 255;
+
+public:
+  template <ESPIChipsets CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+  void addLeds(CRGB* data, int count) {
+    leds = data;
+    numLeds = count;
+  }
+
+  void setBrightness(uint8_t scale) { brightness = scale; }
+  uint8_t getBrightness() { return brightness; }
+
+  CRGB* getLeds() { return leds; }
+  int size() { return numLeds; }
+
+  void show();
+};
+
+extern CFastLED FastLED;
+
+// same power model as FastLED's power_mgt (5V WS2812 at full brightness)
+uint8_t calculate_max_brightness_for_power_mW(const CRGB* leds, uint16_t numLeds, uint8_t targetBrightness, uint32_t maxPower_mW);
+
+namespace hostLeds {
+  // called after every show (optional)
+  extern void (*onShow)();
+}
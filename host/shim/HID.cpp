@@ -0,0 +1,34 @@
+#include "HID.h"
+
+namespace hostHid {
+  void (*onReport)() = NULL;
+}
+
+// constructed on first use, since descriptors are appended from other globals' constructors
+HID_& HID() {
+  static HID_ obj;
+  return obj;
+}
+
+int HID_::AppendDescriptor(HIDSubDescriptor* node) {
+  node->next = rootNode;
+  rootNode = node;
+  return 1;
+}
+
+int HID_::SendReport(uint8_t id, const void* data, int len) {
+  if (len < 0 || len > (int)sizeof(lastReport))
+    return -1;
+
+  // one interrupt IN transfer, the endpoint is polled every 1ms
+  hostClock::spend(10);
+
+  lastReportId = id;
+  memcpy(lastReport, data, len);
+  lastReportLength = len;
+  reports++;
+
+  if (hostHid::onReport)
+    hostHid::onReport();
+  return len + 1;
+}
@@ -0,0 +1,39 @@
+/*
+ * PluggableUSB HID shim -- keeps the descriptors and the last report sent, and calls hostHid::onReport
+ * for every report so tools can see exactly when it would have gone out
+ */
+
+#pragma once
+#include <Arduino.h>
+
+class HIDSubDescriptor {
+public:
+  HIDSubDescriptor *next = NULL;
+  const void* data;
+  const uint16_t length;
+
+  HIDSubDescriptor(const void* d, const uint16_t l) : data(d), length(l) {}
+};
+
+class HID_ {
+public:
+  HIDSubDescriptor* rootNode = NULL;
+
+  // last report sent (without the ID byte)
+  uint8_t lastReportId = 0;
+  uint8_t lastReport[16];
+  uint8_t lastReportLength = 0;
+
+  // reports sent since boot
+  unsigned long reports = 0;
+
+  int AppendDescriptor(HIDSubDescriptor* node);
+  int SendReport(uint8_t id, const void* data, int len);
+};
+
+HID_& HID();
+
+namespace hostHid {
+  // called after every SendReport
+  extern void (*onReport)();
+}
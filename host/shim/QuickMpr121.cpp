@@ -0,0 +1,47 @@
+#include "QuickMpr121.h"
+#include <Wire.h>
+
+static uint8_t nextAddress = 0x5A;
+
+mpr121::mpr121() {
+  address = nextAddress++;
+}
+
+static void writeRegister(uint8_t address, uint8_t reg, uint8_t value) {
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  Wire.write(value);
+  Wire.endTransmission();
+}
+
+static bool readRegisters(uint8_t address, uint8_t reg, uint8_t* buf, uint8_t len) {
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0)
+    return false;
+  if (Wire.requestFrom(address, len) != len)
+    return false;
+  for (uint8_t i = 0; i < len; i++)
+    buf[i] = Wire.read();
+  return true;
+}
+
+void mpr121::begin() {
+  writeRegister(address, 0x80, 0x63); // soft reset
+}
+
+void mpr121::start(uint8_t electrodes) {
+  writeRegister(address, 0x5E, electrodes ? (0x80 | electrodes) : 0); // ECR, with baseline tracking enabled
+}
+
+bool mpr121::checkRunning() {
+  uint8_t ecr;
+  return readRegisters(address, 0x5E, &ecr, 1) && ecr != 0;
+}
+
+short mpr121::readTouchState() {
+  uint8_t status[2];
+  if (!readRegisters(address, 0x00, status, 2))
+    return 0;
+  return (status[0] | (status[1] << 8)) & 0x0FFF;
+}
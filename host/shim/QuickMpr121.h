@@ -0,0 +1,38 @@
+/*
+ * QuickMpr121 shim -- just the parts SlidA uses, talking to mprSim through the Wire shim
+ *
+ * like the real library, default constructed chips take addresses in order from 0x5A
+ */
+
+#pragma once
+#include <Arduino.h>
+
+#define MPR121_USE_BITFIELDS true
+
+enum mpr121ESI : uint8_t {
+  MPR_ESI_1 = 0, MPR_ESI_2, MPR_ESI_4, MPR_ESI_8, MPR_ESI_16, MPR_ESI_32, MPR_ESI_64, MPR_ESI_128
+};
+
+class mpr121 {
+private:
+  uint8_t address;
+
+public:
+  mpr121ESI ESI = MPR_ESI_16;
+  uint8_t autoConfigUSL = 0;
+
+  mpr121();
+  explicit mpr121(uint8_t addr) : address(addr) {}
+
+  // soft reset the chip
+  void begin();
+
+  // enable `electrodes` electrodes (0 = stop mode)
+  void start(uint8_t electrodes);
+  void stop() { start(0); }
+
+  bool checkRunning();
+
+  // touch state of all 12 electrodes as a bitfield
+  short readTouchState();
+};
@@ -0,0 +1,66 @@
+#include "Wire.h"
+#include "mprSim.h"
+
+TwoWire Wire;
+
+// spend the bus time for a transaction with `bytes` bytes after the address
+void TwoWire::spendBusTime(uint8_t address, uint8_t bytes) {
+  // 9 bits per byte (including ack), plus the address byte and a couple of bits for START/STOP
+  uint32_t bits = 9 * (1 + bytes) + 2;
+  uint32_t hz = (address & MPR_SIM_SOFT_BUS) ? MPR_SIM_SOFT_BUS_HZ : clockHz;
+  hostClock::spend(bits * 1000000UL / hz);
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  txAddress = address;
+  txLen = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  if (txLen >= BUFFER_LENGTH)
+    return 0;
+  txBuf[txLen++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t len) {
+  size_t written = 0;
+  while (written < len && write(data[written]))
+    written++;
+  return written;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  spendBusTime(txAddress, txLen);
+
+  mprSim::chip* chip = mprSim::find(txAddress);
+  if (!chip)
+    return 2;
+
+  // first byte sets the register pointer, the rest are written from there
+  if (txLen > 0) {
+    chip->regPointer = txBuf[0];
+    for (uint8_t i = 1; i < txLen; i++)
+      mprSim::writeRegister(*chip, chip->regPointer++, txBuf[i]);
+  }
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+  if (quantity > BUFFER_LENGTH)
+    quantity = BUFFER_LENGTH;
+
+  spendBusTime(address, quantity);
+
+  rxLen = 0;
+  rxPos = 0;
+
+  mprSim::chip* chip = mprSim::find(address);
+  if (!chip)
+    return 0;
+
+  for (uint8_t i = 0; i < quantity; i++)
+    rxBuf[i] = mprSim::readRegister(*chip, chip->regPointer++);
+  rxLen = quantity;
+  return quantity;
+}
@@ -0,0 +1,46 @@
+/*
+ * Wire (I2C master) shim, talking to the simulated MPR121s in mprSim
+ *
+ * each transaction takes as long as it would on the bus at the set clock (via hostClock::spend)
+ * addresses on mprSim's second bus (the softI2c fallback) are timed at MPR_SIM_SOFT_BUS_HZ instead
+ */
+
+#pragma once
+#include <Arduino.h>
+
+#define BUFFER_LENGTH 32
+
+class TwoWire {
+private:
+  uint32_t clockHz = 100000;
+
+  uint8_t txAddress;
+  uint8_t txBuf[BUFFER_LENGTH];
+  uint8_t txLen = 0;
+
+  uint8_t rxBuf[BUFFER_LENGTH];
+  uint8_t rxLen = 0;
+  uint8_t rxPos = 0;
+
+  // spend the bus time for a transaction with `bytes` bytes after the address
+  void spendBusTime(uint8_t address, uint8_t bytes);
+
+public:
+  void begin() {}
+  void setClock(uint32_t hz) { clockHz = hz; }
+
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t* data, size_t len);
+
+  // returns 0 on success, 2 if the address wasn't acknowledged (like the AVR core)
+  uint8_t endTransmission(bool sendStop = true);
+
+  // returns the number of bytes read (0 if the address wasn't acknowledged)
+  uint8_t requestFrom(uint8_t address, uint8_t quantity);
+
+  int available() { return rxLen - rxPos; }
+  int read() { return (rxPos < rxLen) ? rxBuf[rxPos++] : -1; }
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,29 @@
+/*
+ * side channel between the host firmware build (hostMain.cpp) and tools driving it
+ *
+ * messages are fixed size and sent over a SOCK_SEQPACKET socket, so each read is one message
+ * times are CLOCK_MONOTONIC nanoseconds, which both processes share
+ */
+
+#pragma once
+#include <stdint.h>
+
+enum hostControlType : uint8_t {
+  // tool -> firmware
+  HOST_CONTROL_TOUCH = 1, // set raw key `key` touched if `value` is non-zero
+  HOST_CONTROL_BUTTON = 2, // set input pin `key` to level `value`
+
+  // firmware -> tool
+  HOST_CONTROL_LED_SHOW = 0x81, // the strip was updated, `tag` is output LED 0's colour as sent (B << 16 | R << 8 | G)
+  HOST_CONTROL_HID_REPORT = 0x82, // a HID report was sent, `key` is the report ID, `value` the length and `data` the report
+};
+
+struct hostControlMsg {
+  uint8_t type;
+  uint8_t key;
+  uint8_t value;
+  uint8_t reserved;
+  uint32_t tag;
+  uint64_t timeNs;
+  uint8_t data[16];
+};
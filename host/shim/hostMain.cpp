@@ -0,0 +1,150 @@
+/*
+ * main() for the host firmware build: runs SlidA.ino's setup() and loop() in real time
+ *
+ *   slida_fw --tty PATH [--control FD] [--irq-pin N] [--noise N]
+ *
+ * Serial is the tty (normally a pty opened by a tool such as latency_harness), the MPR121s are
+ * simulated by mprSim, and FastLED/HID are shims. with --control, touches and button levels
+ * are taken from hostControlMsg messages on FD and LED shows and HID reports are reported back on it.
+ * --noise adds random noise of up to N counts to the simulated filtered data (see mprSim.h).
+ *
+ * only hardware waits are modelled (I2C transfers, LED updates, delays), the code itself runs at
+ * host speed, so compare timings between builds rather than treating them as AVR numbers.
+ * the TWI registers don't exist here, so background MPR121 reads complete on their first poll.
+ */
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <HID.h>
+#include "mprSim.h"
+#include "hostControl.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// from the sketch
+void setup();
+void loop();
+
+static int controlFd = -1;
+
+static uint64_t monotonicNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// report a strip update with output LED 0's colour, so the tool can match it to the frame it sent
+static void reportLedShow() {
+  if (controlFd < 0 || FastLED.size() == 0)
+    return;
+
+  const CRGB &led = FastLED.getLeds()[0];
+  hostControlMsg msg = {};
+  msg.type = HOST_CONTROL_LED_SHOW;
+  msg.tag = ((uint32_t)led.b << 16) | ((uint32_t)led.r << 8) | led.g;
+  msg.timeNs = monotonicNs();
+  send(controlFd, &msg, sizeof(msg), MSG_DONTWAIT);
+}
+
+// pass a HID report on to the tool
+static void reportHid() {
+  if (controlFd < 0)
+    return;
+
+  hostControlMsg msg = {};
+  msg.type = HOST_CONTROL_HID_REPORT;
+  msg.key = HID().lastReportId;
+  msg.value = HID().lastReportLength;
+  memcpy(msg.data, HID().lastReport, min((size_t)HID().lastReportLength, sizeof(msg.data)));
+  msg.timeNs = monotonicNs();
+  send(controlFd, &msg, sizeof(msg), MSG_DONTWAIT);
+}
+
+// apply any waiting control messages
+// returns false once the tool has gone away
+static bool pollControl() {
+  if (controlFd < 0)
+    return true;
+
+  hostControlMsg msg;
+  ssize_t n;
+  while ((n = recv(controlFd, &msg, sizeof(msg), MSG_DONTWAIT)) == sizeof(msg)) {
+    switch (msg.type) {
+      case HOST_CONTROL_TOUCH:
+        mprSim::setTouch(msg.key, msg.value != 0);
+        break;
+
+      case HOST_CONTROL_BUTTON:
+        if (msg.key < NUM_DIGITAL_PINS)
+          hostPins::inputLevels[msg.key] = msg.value ? HIGH : LOW;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return !(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK));
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "usage: %s --tty PATH [--control FD] [--irq-pin N] [--noise N]\n", name);
+}
+
+int main(int argc, char** argv) {
+  const char* ttyPath = NULL;
+  int irqPin = 4; // PIN_SLIDER_IRQ in pins.h
+  int noiseAmplitude = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--tty") == 0 && i + 1 < argc)
+      ttyPath = argv[++i];
+    else if (strcmp(argv[i], "--control") == 0 && i + 1 < argc)
+      controlFd = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--irq-pin") == 0 && i + 1 < argc)
+      irqPin = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc)
+      noiseAmplitude = atoi(argv[++i]);
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (!ttyPath) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  int ttyFd = open(ttyPath, O_RDWR | O_NOCTTY);
+  if (ttyFd < 0) {
+    perror(ttyPath);
+    return 1;
+  }
+
+  // raw bytes, no echo or line editing (the protocol uses every byte value)
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+
+  hostClock::startRealTime();
+  Serial.attachFd(ttyFd);
+  mprSim::begin(irqPin);
+  mprSim::noiseAmplitude = noiseAmplitude;
+  hostLeds::onShow = reportLedShow;
+  hostHid::onReport = reportHid;
+
+  setup();
+  while (pollControl())
+    loop();
+
+  return 0;
+}
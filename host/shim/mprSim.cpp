@@ -0,0 +1,131 @@
+#include "mprSim.h"
+#include <math.h>
+
+// registers the simulation treats specially (see the MPR121 datasheet)
+#define REG_TOUCH_STATUS_L 0x00
+#define REG_TOUCH_STATUS_H 0x01
+#define REG_FILTERED_DATA 0x04
+#define REG_BASELINE 0x1E
+#define REG_CONFIG1 0x5C
+#define REG_CONFIG2 0x5D
+#define REG_ECR 0x5E
+#define REG_SOFT_RESET 0x80
+
+namespace mprSim {
+  chip chips[MPR_SIM_MAX_CHIPS];
+  uint8_t irqPin;
+  uint8_t noiseAmplitude = 0;
+
+  static void resetChip(chip &c) {
+    memset(c.regs, 0, sizeof(c.regs));
+    memset(c.noise, 0, sizeof(c.noise));
+    c.touches = 0;
+    c.irq = false;
+    c.regPointer = 0;
+  }
+
+  static bool running(const chip &c) {
+    return c.regs[REG_ECR] != 0;
+  }
+
+  // the IRQ line is open drain and shared, so it's low if any chip asserts it
+  static int readIrq(uint8_t pin) {
+    if (pin != irqPin)
+      return -1;
+
+    for (chip &c : chips) {
+      if (c.irq)
+        return LOW;
+    }
+    return HIGH;
+  }
+
+  // new noise for one filtered data read
+  // averaging more samples shrinks random noise by the square root of the sample count
+  static int16_t sampleNoise(const chip &c) {
+    if (noiseAmplitude == 0)
+      return 0;
+
+    static const uint8_t ffiSamples[4] = { 6, 10, 18, 34 };
+    static const uint8_t sfiSamples[4] = { 4, 6, 10, 18 };
+    uint16_t samples = ffiSamples[c.regs[REG_CONFIG1] >> 6] * sfiSamples[(c.regs[REG_CONFIG2] >> 3) & 3];
+    int peak = (int)lround(noiseAmplitude * sqrt(24.0 / samples));
+    return (rand() % (2 * peak + 1)) - peak;
+  }
+
+  void begin(uint8_t irqPinNumber) {
+    for (chip &c : chips)
+      resetChip(c);
+
+    irqPin = irqPinNumber;
+    hostPins::readHook = readIrq;
+  }
+
+  chip* find(uint8_t address) {
+    uint8_t first = 0;
+    if (address & MPR_SIM_SOFT_BUS) {
+      address &= ~MPR_SIM_SOFT_BUS;
+      first = MPR_SIM_CHIPS_PER_BUS;
+    }
+
+    if (address < MPR_SIM_FIRST_ADDRESS || address >= MPR_SIM_FIRST_ADDRESS + MPR_SIM_CHIPS_PER_BUS)
+      return NULL;
+    return &chips[first + address - MPR_SIM_FIRST_ADDRESS];
+  }
+
+  void setTouch(uint8_t rawKey, bool touched) {
+    if (rawKey >= 12 * MPR_SIM_MAX_CHIPS)
+      return;
+
+    chip &c = chips[rawKey / 12];
+    uint16_t bit = 1 << (rawKey % 12);
+    uint16_t newTouches = touched ? (c.touches | bit) : (c.touches & ~bit);
+
+    if (newTouches != c.touches) {
+      c.touches = newTouches;
+      if (running(c))
+        c.irq = true;
+    }
+  }
+
+  uint8_t readRegister(chip &c, uint8_t reg) {
+    uint16_t status = running(c) ? c.touches : 0;
+
+    if (reg == REG_TOUCH_STATUS_L || reg == REG_TOUCH_STATUS_H) {
+      c.irq = false;
+      return (reg == REG_TOUCH_STATUS_L) ? (status & 0xFF) : (status >> 8);
+    }
+
+    if (reg >= REG_FILTERED_DATA && reg < REG_FILTERED_DATA + 2 * 12) {
+      byte electrode = (reg - REG_FILTERED_DATA) / 2;
+      if ((reg - REG_FILTERED_DATA) % 2 == 0) // the high byte is always read after its low byte
+        c.noise[electrode] = sampleNoise(c);
+
+      uint16_t filtered = (MPR_SIM_BASELINE << 2) + c.noise[electrode];
+      if (bitRead(status, electrode))
+        filtered -= MPR_SIM_TOUCH_DELTA;
+      return ((reg - REG_FILTERED_DATA) % 2 == 0) ? (filtered & 0xFF) : (filtered >> 8);
+    }
+
+    if (reg >= REG_BASELINE && reg < REG_BASELINE + 12)
+      return running(c) ? MPR_SIM_BASELINE : 0;
+
+    if (reg < sizeof(c.regs))
+      return c.regs[reg];
+    return 0;
+  }
+
+  void writeRegister(chip &c, uint8_t reg, uint8_t value) {
+    if (reg == REG_SOFT_RESET) {
+      if (value == 0x63)
+        resetChip(c);
+      return;
+    }
+
+    if (reg < sizeof(c.regs))
+      c.regs[reg] = value;
+
+    if (reg == REG_ECR && value == 0)
+      c.irq = false;
+  }
+}
@@ -0,0 +1,59 @@
+/*
+ * simulated MPR121s for the host firmware build, behind the Wire and QuickMpr121 shims
+ *
+ * each chip has a register file at MPR_SIM_FIRST_ADDRESS + n (split over two buses, see MPR_SIM_CHIPS_PER_BUS), with:
+ *   - touch status (only while running, ie. ECR != 0), which asserts the shared IRQ line on change
+ *     and releases it when the status registers are read
+ *   - filtered data that drops below the baseline while touched, plus optional random noise that
+ *     shrinks with the filter settings (CONFIG1 FFI and CONFIG2 SFI), for trying SLIDER_CALIBRATE
+ *   - auto incrementing register reads and writes
+ *
+ * touches are set from outside (eg. the latency harness) with setTouch
+ */
+
+#pragma once
+#include <Arduino.h>
+
+#define MPR_SIM_MAX_CHIPS 8
+#define MPR_SIM_FIRST_ADDRESS 0x5A
+
+// chips past the first MPR_SIM_CHIPS_PER_BUS are on a second bus, at their address | MPR_SIM_SOFT_BUS
+// (where softI2c sends them without port registers), which runs at about the speed of the real soft bus
+#define MPR_SIM_CHIPS_PER_BUS 4
+#define MPR_SIM_SOFT_BUS 0x80
+#define MPR_SIM_SOFT_BUS_HZ 250000
+
+// reported baseline (upper 8 bits) and how far filtered data drops while touched
+#define MPR_SIM_BASELINE 0xB0
+#define MPR_SIM_TOUCH_DELTA 40
+
+namespace mprSim {
+  struct chip {
+    uint8_t regs[0x80];
+    uint16_t touches; // current touch state (electrodes 0-11)
+    bool irq; // touch state changed since the status was last read
+    uint8_t regPointer;
+    int16_t noise[12]; // noise on each electrode's last filtered data read
+  };
+
+  extern chip chips[MPR_SIM_MAX_CHIPS];
+
+  // peak filtered data noise (counts) with the weakest filtering (FFI 6, SFI 4), 0 for none
+  extern uint8_t noiseAmplitude;
+
+  // pin the shared IRQ line is read from (PIN_SLIDER_IRQ)
+  extern uint8_t irqPin;
+
+  // reset every chip and hook the IRQ line into digitalRead
+  void begin(uint8_t irqPinNumber);
+
+  // chip at an I2C address, or NULL if there isn't one
+  chip* find(uint8_t address);
+
+  // set the touch state of a raw key (12 * chip + electrode)
+  void setTouch(uint8_t rawKey, bool touched);
+
+  // register access, as seen over I2C
+  uint8_t readRegister(chip &c, uint8_t reg);
+  void writeRegister(chip &c, uint8_t reg, uint8_t value);
+}
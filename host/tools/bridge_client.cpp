@@ -0,0 +1,169 @@
+/*
+ * example slider_bridge client: reads touch state from the shared memory and (optionally) writes LED frames
+ *
+ *   bridge_client [--shm NAME] [--seconds N] [--leds FPS] [--check]
+ *
+ * prints the board info, every change of touched keys, and at the end:
+ *   - how long a sliderShmReadScan takes (ns per read, from a tight loop)
+ *   - how old scan reports are when they're first seen (bridge receive -> client read)
+ *   - the bridge's counters
+ * --leds writes a moving LED pattern at FPS frames per second (run several clients to see frames merge)
+ * --check exits with an error unless scan reports arrived, and (with --leds) the board received LED frames
+ *         while the client was running and none failed to send, for automated runs
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "sliderShm.h"
+
+// scan reads timed for the read cost figure
+#define READ_COST_ITERATIONS 1000000
+
+// time between polls of the scan report (a real reader would just read when it needs the state)
+#define POLL_INTERVAL_US 100
+
+static sliderShm* openShm(const char* name) {
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd < 0) {
+    perror("shm_open (is slider_bridge running?)");
+    return NULL;
+  }
+
+  void* mem = mmap(NULL, sizeof(sliderShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    perror("mmap");
+    return NULL;
+  }
+
+  sliderShm* shm = (sliderShm*)mem;
+  if (shm->magic.load(std::memory_order_acquire) != SLIDER_SHM_MAGIC || shm->version != SLIDER_SHM_VERSION) {
+    fprintf(stderr, "%s isn't a slider_bridge segment this client understands\n", name);
+    return NULL;
+  }
+  return shm;
+}
+
+// nearest-rank percentile of sorted values
+static double percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  return sorted[(size_t)(p / 100.0 * (sorted.size() - 1) + 0.5)];
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "usage: %s [--shm NAME] [--seconds N] [--leds FPS] [--check]\n", name);
+}
+
+int main(int argc, char** argv) {
+  const char* shmName = SLIDER_SHM_NAME;
+  double seconds = 5;
+  double ledFps = 0;
+  bool check = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc)
+      shmName = argv[++i];
+    else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+      seconds = atof(argv[++i]);
+    else if (strcmp(argv[i], "--leds") == 0 && i + 1 < argc)
+      ledFps = atof(argv[++i]);
+    else if (strcmp(argv[i], "--check") == 0)
+      check = true;
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  sliderShm* shm = openShm(shmName);
+  if (!shm)
+    return 1;
+
+  printf("board %.8s (%.5s), bridge pid %u\n", shm->info.model, shm->info.chipNumber, shm->bridgePid);
+
+  // read cost
+  sliderShmScan scan;
+  uint64_t start = sliderShmNowNs();
+  for (unsigned long i = 0; i < READ_COST_ITERATIONS; i++)
+    sliderShmReadScan(shm, scan);
+  double readNs = (double)(sliderShmNowNs() - start) / READ_COST_ITERATIONS;
+
+  uint32_t firstCount = 0, lastCount = 0;
+  uint32_t firstBoardLeds = shm->boardLedPackets.load(std::memory_order_relaxed);
+  std::vector<double> ageUs;
+  byte lastKeys[SLIDER_SHM_MAX_KEYS] = {};
+  unsigned long ledFrames = 0;
+
+  uint64_t endNs = sliderShmNowNs() + (uint64_t)(seconds * 1e9);
+  uint64_t nextLedNs = 0;
+  while (sliderShmNowNs() < endNs && shm->running.load(std::memory_order_acquire)) {
+    if (sliderShmReadScan(shm, scan) && scan.count != lastCount) {
+      uint64_t now = sliderShmNowNs();
+      if (firstCount == 0)
+        firstCount = scan.count;
+      else
+        ageUs.push_back((now - scan.receivedNs) / 1000.0);
+      lastCount = scan.count;
+
+      if (memcmp(lastKeys, scan.keys, scan.keyCount) != 0) {
+        printf("scan %6u  keys", scan.count);
+        for (byte k = 0; k < scan.keyCount; k++) {
+          if (scan.keys[k])
+            printf(" %d", k);
+        }
+        printf("\n");
+        memcpy(lastKeys, scan.keys, scan.keyCount);
+      }
+    }
+
+    if (ledFps > 0 && sliderShmNowNs() >= nextLedNs) {
+      // one lit key moving along the strip (brightness byte, then BRG per LED)
+      byte frame[1 + 3 * 31] = { 0x3F };
+      byte lit = ledFrames % 31;
+      frame[1 + 3 * lit] = 0xFF;
+      sliderShmWriteLed(shm, frame, sizeof(frame));
+      ledFrames++;
+      nextLedNs = sliderShmNowNs() + (uint64_t)(1e9 / ledFps);
+    }
+
+    usleep(POLL_INTERVAL_US);
+  }
+
+  std::sort(ageUs.begin(), ageUs.end());
+  uint32_t scansSeen = lastCount - firstCount;
+  printf("\nread cost            %.1f ns per sliderShmReadScan\n", readNs);
+  printf("scan reports         %u new while running", scansSeen);
+  if (!ageUs.empty())
+    printf(", age when seen p50 %.0f us p99 %.0f us", percentile(ageUs, 50), percentile(ageUs, 99));
+  printf("\nLED frames written   %lu\n", ledFrames);
+  printf("bridge               %u LED frames sent (%u merged, %u send failures), %u checksum errors, %u dropped frames\n",
+         shm->ledFramesSent.load(), shm->ledFramesMerged.load(), shm->ledSendFailures.load(),
+         shm->checksumErrors.load(), shm->droppedFrames.load());
+  // the bridge reads this from the board every so often, so it can be a little behind
+  uint32_t boardLeds = shm->boardLedPackets.load(std::memory_order_relaxed) - firstBoardLeds;
+  printf("board                %u LED packets received\n", boardLeds);
+
+  if (check) {
+    const char* failure = NULL;
+    if (scansSeen == 0)
+      failure = "no scan reports";
+    else if (ledFps > 0 && shm->ledSendFailures.load() > 0)
+      failure = "LED frames failed to send";
+    else if (ledFps > 0 && boardLeds == 0)
+      failure = "no LED frames reached the board";
+
+    if (failure) {
+      fprintf(stderr, "check failed: %s\n", failure);
+      return 1;
+    }
+  }
+  return 0;
+}
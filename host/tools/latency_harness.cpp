@@ -0,0 +1,526 @@
+/*
+ * end-to-end latency harness: plays the game's side of the slider protocol against the
+ * host firmware build (slida_fw) over a pty
+ *
+ *   latency_harness [--fw PATH] [--seconds N] [--fps LIST]
+ *
+ * after the normal startup sequence (SLIDER_DETECT, SLIDER_BOARDINFO, SLIDER_SCAN_ON) it runs one
+ * phase per LED frame rate in LIST (default 0,60,120,240), and during each phase:
+ *   - sends LED frames at that rate, tagged through LED 0's colour
+ *   - toggles a random key every 20-40ms through the MPR121 simulation
+ *   - toggles a random button every 50-100ms through its input pin
+ * then prints percentiles for
+ *   - touch -> SCAN_REPORT latency (injecting the touch until a report shows it)
+ *   - button -> HID report latency (changing the pin until a keyboard report shows it)
+ *   - report interval (time between SCAN_REPORTs, ie. jitter)
+ *   - LED frame -> show latency (frame written until the strip update containing it)
+ *
+ * firmware code runs at host speed and only hardware waits are simulated (see hostMain.cpp),
+ * so use this to compare loop tunables and builds, not as absolute AVR numbers
+ */
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "segaSlider.h"
+#include "pins.h"
+#include "nkroKeyboard.h"
+#include "hostControl.h"
+
+// keys the harness touches (raw key n is protocol key n with divaSlider)
+#define HARNESS_KEYS 32
+
+// give up on a touch or button change if no report shows it within this long
+#define TOUCH_TIMEOUT_NS 200000000ULL
+
+
+static uint64_t monotonicNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// collected samples for one measurement, in nanoseconds
+struct sampleSet {
+  std::vector<uint64_t> samples;
+
+  void add(uint64_t ns) { samples.push_back(ns); }
+
+  // nearest-rank percentile
+  double percentileMs(double p) {
+    if (samples.empty())
+      return 0;
+    size_t rank = (size_t)(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[rank] / 1e6;
+  }
+
+  void print(const char* name) {
+    std::sort(samples.begin(), samples.end());
+    if (samples.empty()) {
+      printf("  %-20s n=0\n", name);
+      return;
+    }
+    printf("  %-20s n=%-6zu p50 %7.3f ms  p90 %7.3f ms  p99 %7.3f ms  max %7.3f ms\n",
+           name, samples.size(), percentileMs(50), percentileMs(90), percentileMs(99), samples.back() / 1e6);
+  }
+};
+
+
+// game side of the connection
+class harness {
+public:
+  int ptyFd = -1;
+  int controlFd = -1;
+  pid_t fwPid = -1;
+
+  HostSerial port; // the pty, wrapped so segaSlider can parse replies
+  segaSlider<sliderStreamTransport> proto = segaSlider<sliderStreamTransport>(&port);
+
+  std::mt19937 rng = std::mt19937(1234);
+
+  // last reported key values, and the time of the last report
+  byte keys[HARNESS_KEYS] = {};
+  uint64_t lastReportNs = 0;
+  unsigned long reports = 0;
+
+  // touch waiting to show up in a report
+  bool touchPending = false;
+  byte touchKey;
+  bool touchState;
+  uint64_t touchNs;
+  unsigned long touchTimeouts = 0;
+
+  // button change waiting to show up in a HID report
+  bool buttonPending = false;
+  byte buttonIndex; // into kbButtons
+  bool buttonState;
+  uint64_t buttonNs;
+  byte buttonsHeld = 0; // bit n is kbButtons[n]
+  unsigned long buttonTimeouts = 0;
+
+  // LED frames sent but not seen on the strip yet, by tag
+  std::map<uint32_t, uint64_t> ledFramesSent;
+  uint32_t ledSeq = 0;
+  unsigned long ledFramesShown = 0;
+
+  sampleSet touchLatency;
+  sampleSet buttonLatency;
+  sampleSet reportInterval;
+  sampleSet ledLatency;
+
+  bool start(const char* fwPath);
+  void stop();
+
+  void sendRaw(const byte* data, size_t len);
+  void sendPacket(byte command, const byte* data, byte len);
+
+  // wait up to timeoutMs for a packet with `command`, handling everything else that arrives
+  bool waitFor(byte command, sliderPacket &out, int timeoutMs);
+
+  // handle everything waiting on the pty and control socket
+  void pump(sliderPacket* wanted = NULL, byte wantedCommand = 0, bool* found = NULL);
+
+  void handleReport(const sliderPacket &pkt, uint64_t now);
+  void handleControl(const hostControlMsg &msg);
+
+  void sendLedFrame();
+  void setTouch(byte key, bool touched);
+  void setButton(byte index, bool pressed);
+
+  void runPhase(int fps, double seconds);
+  void resetStats();
+};
+
+
+// start slida_fw on a new pty
+bool harness::start(const char* fwPath) {
+  ptyFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (ptyFd < 0 || grantpt(ptyFd) != 0 || unlockpt(ptyFd) != 0) {
+    perror("pty");
+    return false;
+  }
+  std::string ttyPath = ptsname(ptyFd);
+
+  // raw mode on the pair (set from the master side, the firmware sets it again when opening)
+  struct termios tio;
+  if (tcgetattr(ptyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(ptyFd, TCSANOW, &tio);
+  }
+
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) != 0) {
+    perror("socketpair");
+    return false;
+  }
+
+  fwPid = fork();
+  if (fwPid == 0) {
+    close(sv[0]);
+    close(ptyFd);
+    std::string fd = std::to_string(sv[1]);
+    execl(fwPath, fwPath, "--tty", ttyPath.c_str(), "--control", fd.c_str(), (char*)NULL);
+    perror(fwPath);
+    _exit(127);
+  }
+  close(sv[1]);
+  controlFd = sv[0];
+
+  port.attachFd(ptyFd);
+  return fwPid > 0;
+}
+
+void harness::stop() {
+  if (fwPid > 0) {
+    close(controlFd); // the firmware exits when the control socket closes
+    kill(fwPid, SIGTERM);
+    waitpid(fwPid, NULL, 0);
+  }
+}
+
+void harness::sendRaw(const byte* data, size_t len) {
+  port.write(data, len);
+}
+
+// encode and send a packet (segaSlider::sendPacket only handles board-sized packets, LED frames are bigger)
+void harness::sendPacket(byte command, const byte* data, byte len) {
+  byte frame[SLIDER_FRAME_MAX_SIZE(255)];
+  size_t pos = 0;
+  byte checksum = 0;
+  checksum -= SLIDER_FRAMING_START;
+
+  auto put = [&](byte b) {
+    checksum -= b;
+    if (b == SLIDER_FRAMING_START || b == SLIDER_FRAMING_ESCAPE) {
+      frame[pos++] = SLIDER_FRAMING_ESCAPE;
+      frame[pos++] = b - 1;
+    }
+    else {
+      frame[pos++] = b;
+    }
+  };
+
+  frame[pos++] = SLIDER_FRAMING_START;
+  put(command);
+  put(len);
+  for (byte i = 0; i < len; i++)
+    put(data[i]);
+  put(checksum); // the checksum byte is escaped like anything else (what it does to `checksum` doesn't matter)
+
+  sendRaw(frame, pos);
+}
+
+void harness::handleReport(const sliderPacket &pkt, uint64_t now) {
+  if (lastReportNs != 0)
+    reportInterval.add(now - lastReportNs);
+  lastReportNs = now;
+  reports++;
+
+  for (byte i = 0; i < HARNESS_KEYS && i < pkt.DataLength; i++)
+    keys[i] = pkt.Data[i];
+
+  if (touchPending && ((keys[touchKey] != 0) == touchState)) {
+    touchLatency.add(now - touchNs);
+    touchPending = false;
+  }
+}
+
+void harness::handleControl(const hostControlMsg &msg) {
+  if (msg.type == HOST_CONTROL_HID_REPORT) {
+    byte usage = kbButtons[buttonIndex].usage;
+    if (buttonPending && msg.key == NKRO_REPORT_ID && msg.value == NKRO_REPORT_LEN &&
+        (bool)bitRead(msg.data[1 + usage / 8], usage % 8) == buttonState) {
+      buttonLatency.add(msg.timeNs - buttonNs);
+      buttonPending = false;
+    }
+    return;
+  }
+
+  if (msg.type != HOST_CONTROL_LED_SHOW)
+    return;
+
+  auto it = ledFramesSent.find(msg.tag);
+  if (it == ledFramesSent.end())
+    return; // not one of ours (eg. the boot colours)
+
+  ledLatency.add(msg.timeNs - it->second);
+  ledFramesShown++;
+
+  // anything older was merged into this frame and will never be shown
+  ledFramesSent.erase(ledFramesSent.begin(), ++it);
+}
+
+void harness::pump(sliderPacket* wanted, byte wantedCommand, bool* found) {
+  hostControlMsg msg;
+  while (recv(controlFd, &msg, sizeof(msg), MSG_DONTWAIT) == sizeof(msg))
+    handleControl(msg);
+
+  while (true) {
+    sliderPacket pkt = proto.getPacket();
+    if (pkt.Command == (sliderCommand)0)
+      break;
+
+    uint64_t now = monotonicNs();
+    if (!pkt.IsValid) {
+      fprintf(stderr, "bad checksum on command %02x\n", pkt.Command);
+      continue;
+    }
+
+    if (pkt.Command == SLIDER_SCAN_REPORT)
+      handleReport(pkt, now);
+
+    if (wanted && pkt.Command == wantedCommand && !*found) {
+      *wanted = pkt;
+      *found = true;
+      return; // pkt.Data is only valid until the next getPacket
+    }
+  }
+}
+
+bool harness::waitFor(byte command, sliderPacket &out, int timeoutMs) {
+  uint64_t end = monotonicNs() + (uint64_t)timeoutMs * 1000000;
+  bool found = false;
+  while (monotonicNs() < end) {
+    pump(&out, command, &found);
+    if (found)
+      return true;
+
+    struct pollfd pfd = { ptyFd, POLLIN, 0 };
+    poll(&pfd, 1, 1);
+  }
+  return false;
+}
+
+// send an LED frame with a unique colour on LED 0, so its show can be matched
+void harness::sendLedFrame() {
+  byte data[1 + 3 * 32];
+  data[0] = 0x3f;
+  for (int i = 1; i < (int)sizeof(data); i++)
+    data[i] = (byte)(i * 7);
+
+  ledSeq = (ledSeq + 1) & 0xFFFFFF;
+  data[1] = ledSeq >> 16; // B
+  data[2] = ledSeq >> 8; // R
+  data[3] = ledSeq; // G
+
+  ledFramesSent[ledSeq] = monotonicNs();
+  sendPacket(SLIDER_LED, data, sizeof(data));
+}
+
+void harness::setTouch(byte key, bool touched) {
+  hostControlMsg msg = {};
+  msg.type = HOST_CONTROL_TOUCH;
+  msg.key = key;
+  msg.value = touched;
+
+  touchPending = true;
+  touchKey = key;
+  touchState = touched;
+  touchNs = monotonicNs();
+  send(controlFd, &msg, sizeof(msg), 0);
+}
+
+// buttons are active low, like the real inputs with their pullups
+void harness::setButton(byte index, bool pressed) {
+  hostControlMsg msg = {};
+  msg.type = HOST_CONTROL_BUTTON;
+  msg.key = kbButtons[index].pin;
+  msg.value = pressed ? LOW : HIGH;
+
+  if (pressed)
+    buttonsHeld |= 1 << index;
+  else
+    buttonsHeld &= ~(1 << index);
+
+  buttonPending = true;
+  buttonIndex = index;
+  buttonState = pressed;
+  buttonNs = monotonicNs();
+  send(controlFd, &msg, sizeof(msg), 0);
+}
+
+void harness::resetStats() {
+  touchLatency = sampleSet();
+  buttonLatency = sampleSet();
+  reportInterval = sampleSet();
+  ledLatency = sampleSet();
+  ledFramesSent.clear();
+  ledFramesShown = 0;
+  touchTimeouts = 0;
+  buttonTimeouts = 0;
+  reports = 0;
+  lastReportNs = 0;
+}
+
+void harness::runPhase(int fps, double seconds) {
+  resetStats();
+
+  uint64_t start = monotonicNs();
+  uint64_t end = start + (uint64_t)(seconds * 1e9);
+  uint64_t ledPeriod = fps > 0 ? 1000000000ULL / fps : 0;
+  uint64_t nextLed = start;
+  uint64_t nextTouch = start + 20000000;
+  uint64_t nextButton = start + 50000000;
+  unsigned long ledFramesTotal = 0;
+  std::uniform_int_distribution<int> keyDist(0, HARNESS_KEYS - 1);
+  std::uniform_int_distribution<int> gapDist(20, 40);
+  std::uniform_int_distribution<int> buttonDist(0, sizeof(kbButtons) / sizeof(kbInput) - 1);
+  std::uniform_int_distribution<int> buttonGapDist(50, 100);
+
+  while (true) {
+    uint64_t now = monotonicNs();
+    if (now >= end)
+      break;
+
+    if (ledPeriod && now >= nextLed) {
+      sendLedFrame();
+      ledFramesTotal++;
+      nextLed += ledPeriod;
+    }
+    else if (!ledPeriod && now >= nextLed) {
+      // keep the serial timeout from expiring without LED frames
+      sendPacket(SLIDER_DETECT, NULL, 0);
+      nextLed += 1000000000ULL;
+    }
+
+    if (touchPending && now - touchNs > TOUCH_TIMEOUT_NS) {
+      touchTimeouts++;
+      touchPending = false;
+    }
+
+    if (!touchPending && now >= nextTouch) {
+      byte key = keyDist(rng);
+      setTouch(key, keys[key] == 0);
+      nextTouch = now + (uint64_t)gapDist(rng) * 1000000;
+    }
+
+    if (buttonPending && now - buttonNs > TOUCH_TIMEOUT_NS) {
+      buttonTimeouts++;
+      buttonPending = false;
+    }
+
+    if (!buttonPending && now >= nextButton) {
+      byte index = buttonDist(rng);
+      setButton(index, !(buttonsHeld & (1 << index)));
+      nextButton = now + (uint64_t)buttonGapDist(rng) * 1000000;
+    }
+
+    pump();
+
+    // sleep until there's something to read or send
+    // (don't spin -- the firmware already busy-loops, and on a single core that would add whole timeslices)
+    uint64_t wake = std::min<uint64_t>(std::min(nextLed, end), touchPending ? touchNs + TOUCH_TIMEOUT_NS : nextTouch);
+    wake = std::min<uint64_t>(wake, buttonPending ? buttonNs + TOUCH_TIMEOUT_NS : nextButton);
+    now = monotonicNs();
+    if (wake > now) {
+      struct timespec timeout = { (time_t)((wake - now) / 1000000000ULL), (long)((wake - now) % 1000000000ULL) };
+      struct pollfd pfds[2] = { { ptyFd, POLLIN, 0 }, { controlFd, POLLIN, 0 } };
+      ppoll(pfds, 2, &timeout, NULL);
+    }
+  }
+
+  if (fps > 0)
+    printf("phase: LED frames at %d fps (%.1f s)\n", fps, seconds);
+  else
+    printf("phase: no LED frames (%.1f s)\n", seconds);
+
+  touchLatency.print("touch -> report");
+  buttonLatency.print("button -> HID report");
+  reportInterval.print("report interval");
+  if (fps > 0) {
+    ledLatency.print("LED frame -> show");
+    printf("  %-20s %lu of %lu shown (the rest were merged into newer frames)\n", "LED frames", ledFramesShown, ledFramesTotal);
+  }
+  if (touchTimeouts > 0)
+    printf("  %-20s %lu\n", "touch timeouts", touchTimeouts);
+  if (buttonTimeouts > 0)
+    printf("  %-20s %lu\n", "button timeouts", buttonTimeouts);
+  printf("\n");
+}
+
+
+static void usage(const char* name) {
+  fprintf(stderr, "usage: %s [--fw PATH] [--seconds N] [--fps LIST]\n", name);
+}
+
+int main(int argc, char** argv) {
+  std::string fwPath = "build/slida_fw";
+  double seconds = 3;
+  std::vector<int> fpsList = { 0, 60, 120, 240 };
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--fw") == 0 && i + 1 < argc) {
+      fwPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+      fpsList.clear();
+      std::string list = argv[++i];
+      size_t pos = 0;
+      while (pos <= list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos)
+          comma = list.size();
+        fpsList.push_back(atoi(list.substr(pos, comma - pos).c_str()));
+        pos = comma + 1;
+      }
+    }
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  hostClock::startRealTime(); // segaSlider's send timeouts use millis()
+
+  harness h;
+  if (!h.start(fwPath.c_str()))
+    return 1;
+
+  sliderPacket pkt;
+  bool ok = true;
+
+  h.sendPacket(SLIDER_DETECT, NULL, 0);
+  ok = ok && h.waitFor(SLIDER_DETECT, pkt, 2000);
+
+  h.sendPacket(SLIDER_BOARDINFO, NULL, 0);
+  ok = ok && h.waitFor(SLIDER_BOARDINFO, pkt, 1000);
+  if (ok && pkt.DataLength >= sizeof(boardInfo)) {
+    const boardInfo* info = (const boardInfo*)pkt.Data;
+    printf("board: %.8s chip %.5s fw %02x\n\n", info->model, info->chipNumber, info->fwVer);
+  }
+
+  h.sendPacket(SLIDER_SCAN_ON, NULL, 0);
+  ok = ok && h.waitFor(SLIDER_SCAN_REPORT, pkt, 1000);
+
+  if (!ok) {
+    fprintf(stderr, "firmware didn't respond to the startup sequence\n");
+    h.stop();
+    return 1;
+  }
+
+  for (int fps : fpsList)
+    h.runPhase(fps, seconds);
+
+  h.sendPacket(SLIDER_SCAN_OFF, NULL, 0);
+  h.waitFor(SLIDER_SCAN_OFF, pkt, 1000);
+
+  h.stop();
+  return 0;
+}
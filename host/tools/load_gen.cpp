@@ -0,0 +1,308 @@
+/*
+ * load generator driver: runs SlidA's synthetic touch load (SLIDER_LOADGEN, see loadGen.h) and reports how it kept up
+ *
+ *   load_gen --tty PATH [options]
+ *   load_gen --fw PATH [options]
+ *
+ * --tty drives a board on a serial port, which should be idle apart from this
+ * --fw starts the host firmware build on a pty instead
+ *
+ * options:
+ *   --pattern NAME   glissando (default), slam or taps
+ *   --fingers N      fingers for glissando and taps (default 4)
+ *   --rate HZ        pattern steps per second (default 200)
+ *   --flood          send reports as fast as the firmware can, rather than once per step
+ *   --leds           also push a new LED frame to the strip on every step
+ *   --seconds N      length of the run (default 5)
+ *   --check          exit with an error if any report failed to send or didn't arrive, or more than
+ *                    CHECK_MAX_SKIPPED_PERCENT of the steps were skipped, for automated runs
+ *                    (skipped steps are allowed with --flood, where the reads set the pace)
+ *
+ * prints the received report rate every second, then the firmware's counters for the whole run
+ * reports are counted between the start and stop responses, so the received count should match the sent count exactly
+ */
+
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "segaSlider.h"
+#include "loadGen.h"
+
+// how long to wait for each command response
+#define RESPONSE_TIMEOUT_MS 1000
+
+// send a SLIDER_LOADGEN query this often, which also keeps the firmware from timing out and stopping scanning
+#define QUERY_MS 1000
+
+// most steps --check lets through as skipped (the host build runs in real time next to everything else on the machine,
+// so it can miss the odd step to OS scheduling without the report path being too slow)
+#define CHECK_MAX_SKIPPED_PERCENT 2
+
+
+static int ttyFd = -1;
+static pid_t fwPid = -1;
+static HostSerial port;
+static segaSlider<sliderStreamTransport> proto(&port);
+
+// scan reports received while the run was going
+static unsigned long reportsReceived = 0;
+static bool runGoing = false;
+
+static bool openTty(const char* path) {
+  ttyFd = open(path, O_RDWR | O_NOCTTY);
+  if (ttyFd < 0) {
+    perror(path);
+    return false;
+  }
+
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B115200);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+  tcflush(ttyFd, TCIOFLUSH);
+
+  port.attachFd(ttyFd);
+  return true;
+}
+
+// start slida_fw on a new pty (like trace_dump)
+static bool startFirmware(const char* fwPath) {
+  ttyFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (ttyFd < 0 || grantpt(ttyFd) != 0 || unlockpt(ttyFd) != 0) {
+    perror("pty");
+    return false;
+  }
+  std::string ttyPath = ptsname(ttyFd);
+
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+
+  fwPid = fork();
+  if (fwPid == 0) {
+    close(ttyFd);
+    execl(fwPath, fwPath, "--tty", ttyPath.c_str(), (char*)NULL);
+    perror(fwPath);
+    _exit(127);
+  }
+
+  port.attachFd(ttyFd);
+  return fwPid > 0;
+}
+
+static unsigned long nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+static void sendPacket(byte command, const byte* data, byte len) {
+  sliderPacket pkt = { (sliderCommand)command, (byte*)data, len, true };
+  proto.sendPacket(pkt);
+}
+
+// handle everything waiting on the serial port, counting scan reports from the run
+// returns true as soon as a packet with `command` arrives (0 to just drain)
+static bool receivePackets(byte command, sliderPacket &out) {
+  while (true) {
+    sliderPacket pkt = proto.getPacket();
+    if (pkt.Command == (sliderCommand)0)
+      return false;
+    if (!pkt.IsValid)
+      continue;
+
+    if (pkt.Command == SLIDER_SCAN_REPORT && runGoing)
+      reportsReceived++;
+    if (command && pkt.Command == (sliderCommand)command) {
+      out = pkt;
+      return true;
+    }
+  }
+}
+
+// wait up to timeoutMs for a packet with `command`
+static bool waitFor(byte command, sliderPacket &out, int timeoutMs) {
+  unsigned long start = nowMs();
+
+  while (!receivePackets(command, out)) {
+    int elapsedMs = nowMs() - start;
+    if (elapsedMs >= timeoutMs)
+      return false;
+
+    struct pollfd pfd = { ttyFd, POLLIN, 0 };
+    poll(&pfd, 1, timeoutMs - elapsedMs);
+  }
+  return true;
+}
+
+// send SLIDER_LOADGEN (settings = NULL to query) and wait for the report
+static bool loadGenCommand(const loadGenSettings* settings, loadGenReport &report) {
+  sendPacket(SLIDER_LOADGEN, (const byte*)settings, settings ? sizeof(loadGenSettings) : 0);
+
+  sliderPacket pkt;
+  if (!waitFor(SLIDER_LOADGEN, pkt, RESPONSE_TIMEOUT_MS) || pkt.DataLength < sizeof(loadGenReport))
+    return false;
+  memcpy(&report, pkt.Data, sizeof(report));
+  return true;
+}
+
+static const char* const patternNames[NUM_LOADGEN_PATTERNS] = { "off", "glissando", "slam", "taps" };
+
+static void usage(const char* name) {
+  fprintf(stderr, "usage: %s --tty PATH | --fw PATH [--pattern glissando|slam|taps] [--fingers N] [--rate HZ]\n"
+                  "       [--flood] [--leds] [--seconds N] [--check]\n", name);
+}
+
+int main(int argc, char** argv) {
+  const char* ttyPath = NULL;
+  const char* fwPath = NULL;
+  loadGenSettings settings = { LOADGEN_GLISSANDO, 4, 0, 200 };
+  double seconds = 5;
+  bool check = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--tty") == 0 && i + 1 < argc)
+      ttyPath = argv[++i];
+    else if (strcmp(argv[i], "--fw") == 0 && i + 1 < argc)
+      fwPath = argv[++i];
+    else if (strcmp(argv[i], "--pattern") == 0 && i + 1 < argc) {
+      const char* name = argv[++i];
+      settings.pattern = LOADGEN_OFF;
+      for (byte p = LOADGEN_OFF + 1; p < NUM_LOADGEN_PATTERNS; p++) {
+        if (strcmp(name, patternNames[p]) == 0)
+          settings.pattern = p;
+      }
+      if (settings.pattern == LOADGEN_OFF) {
+        usage(argv[0]);
+        return 2;
+      }
+    }
+    else if (strcmp(argv[i], "--fingers") == 0 && i + 1 < argc)
+      settings.fingers = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+      settings.stepHz = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--flood") == 0)
+      settings.flags |= LOADGEN_FLAG_FLOOD;
+    else if (strcmp(argv[i], "--leds") == 0)
+      settings.flags |= LOADGEN_FLAG_LEDS;
+    else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+      seconds = atof(argv[++i]);
+    else if (strcmp(argv[i], "--check") == 0)
+      check = true;
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!ttyPath == !fwPath) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (fwPath ? !startFirmware(fwPath) : !openTty(ttyPath))
+    return 1;
+
+  bool ok = true;
+  sliderPacket pkt;
+  loadGenReport report;
+
+  // scanning has to be on for a run to start (SLIDER_SCAN_ON is answered with a scan report)
+  sendPacket(SLIDER_SCAN_ON, NULL, 0);
+  if (!waitFor(SLIDER_SCAN_REPORT, pkt, RESPONSE_TIMEOUT_MS)) {
+    fprintf(stderr, "no response to scan on\n");
+    ok = false;
+  }
+  else if (!loadGenCommand(&settings, report) || !report.running) {
+    fprintf(stderr, "the load generator didn't start (is the firmware built with LOADGEN_ENABLED?)\n");
+    ok = false;
+  }
+
+  if (ok) {
+    printf("%s, %d fingers, %d steps/s%s%s\n", patternNames[settings.pattern], report.settings.fingers, settings.stepHz,
+           (settings.flags & LOADGEN_FLAG_FLOOD) ? ", flooding" : "", (settings.flags & LOADGEN_FLAG_LEDS) ? ", LEDs" : "");
+    runGoing = true;
+
+    unsigned long startMs = nowMs(), lastQueryMs = startMs;
+    unsigned long lastReceived = 0, lastSent = 0, lastFailures = 0;
+    while (nowMs() - startMs < seconds * 1000) {
+      struct pollfd pfd = { ttyFd, POLLIN, 0 };
+      poll(&pfd, 1, 50);
+      receivePackets(0, pkt);
+
+      if (nowMs() - lastQueryMs >= QUERY_MS) {
+        if (!loadGenCommand(NULL, report) || !report.running) {
+          fprintf(stderr, "the load generator stopped\n");
+          ok = false;
+          break;
+        }
+        printf("%6lu reports/s received  %6lu sent  %4lu send failures\n", reportsReceived - lastReceived,
+               (unsigned long)report.reports - lastSent, (unsigned long)report.sendFailures - lastFailures);
+        lastReceived = reportsReceived;
+        lastSent = report.reports;
+        lastFailures = report.sendFailures;
+        lastQueryMs = nowMs();
+      }
+    }
+
+    // stopping answers with the final counters, and nothing after that is part of the run
+    loadGenSettings stop = { LOADGEN_OFF, 0, 0, 0 };
+    if (ok && !loadGenCommand(&stop, report)) {
+      fprintf(stderr, "no response to stopping the load generator\n");
+      ok = false;
+    }
+    runGoing = false;
+
+    sendPacket(SLIDER_SCAN_OFF, NULL, 0);
+    waitFor(SLIDER_SCAN_OFF, pkt, RESPONSE_TIMEOUT_MS);
+
+    if (ok) {
+      double runSeconds = report.elapsedMillis / 1000.0;
+      double skippedPercent = report.steps ? 100.0 * report.skippedSteps / report.steps : 0;
+      printf("\nrun                  %.2f s, %lu steps (%lu skipped, %.2f%%)\n", runSeconds,
+             (unsigned long)report.steps, (unsigned long)report.skippedSteps, skippedPercent);
+      printf("reports              %lu sent (%.0f/s), %lu send failures, %lu received (%ld missing)\n",
+             (unsigned long)report.reports, report.reports / runSeconds, (unsigned long)report.sendFailures,
+             reportsReceived, (long)report.reports - (long)reportsReceived);
+      printf("main loop            %lu passes (%.0f/s), %lu task overruns, %lu deferrals\n",
+             (unsigned long)report.loops, report.loops / runSeconds, (unsigned long)report.overruns,
+             (unsigned long)report.deferrals);
+      printf("parser               %lu dropped frames\n", (unsigned long)proto.getDroppedFrames());
+
+      if (check) {
+        const char* failure = NULL;
+        if (report.reports == 0)
+          failure = "no reports sent";
+        else if (report.sendFailures > 0)
+          failure = "reports failed to send";
+        else if (reportsReceived != report.reports)
+          failure = "reports went missing";
+        else if (skippedPercent > CHECK_MAX_SKIPPED_PERCENT && !(settings.flags & LOADGEN_FLAG_FLOOD))
+          failure = "too many steps were skipped";
+
+        if (failure) {
+          fprintf(stderr, "check failed: %s\n", failure);
+          ok = false;
+        }
+      }
+    }
+  }
+
+  if (fwPid > 0) {
+    kill(fwPid, SIGTERM);
+    waitpid(fwPid, NULL, 0);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+/*
+ * profiler readout: reads every SlidA profiler probe with SLIDER_PROFILE and prints its latency distribution
+ *
+ *   profile_dump --tty PATH [--seconds N]
+ *   profile_dump --fw PATH [--seconds N]
+ *
+ * --tty reads from a board on a serial port, which should be idle apart from this
+ * --fw starts the host firmware build on a pty instead (its times are host times, so this is only for trying it out)
+ * --seconds resets every probe, scans for N seconds, then reads them (default: read them as they are)
+ *
+ * the percentiles are bucket limits (the board only keeps doubling buckets), so p50 "< 256" means somewhere in 128-255us
+ * to get the scan time for a chip count, build the firmware with that NUM_MPRS and read `i2cscan` (and `softi2c`)
+ */
+
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "segaSlider.h"
+#include "profiler.h"
+
+// how long to wait for each command response
+#define RESPONSE_TIMEOUT_MS 1000
+
+// send SLIDER_DETECT this often while scanning, so the firmware doesn't time out and stop
+#define KEEPALIVE_MS 1000
+
+
+static int ttyFd = -1;
+static pid_t fwPid = -1;
+static HostSerial port;
+static segaSlider<sliderStreamTransport> proto(&port);
+
+static bool openTty(const char* path) {
+  ttyFd = open(path, O_RDWR | O_NOCTTY);
+  if (ttyFd < 0) {
+    perror(path);
+    return false;
+  }
+
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B115200);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+  tcflush(ttyFd, TCIOFLUSH);
+
+  port.attachFd(ttyFd);
+  return true;
+}
+
+// start slida_fw on a new pty (like trace_dump)
+static bool startFirmware(const char* fwPath) {
+  ttyFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (ttyFd < 0 || grantpt(ttyFd) != 0 || unlockpt(ttyFd) != 0) {
+    perror("pty");
+    return false;
+  }
+  std::string ttyPath = ptsname(ttyFd);
+
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+
+  fwPid = fork();
+  if (fwPid == 0) {
+    close(ttyFd);
+    execl(fwPath, fwPath, "--tty", ttyPath.c_str(), (char*)NULL);
+    perror(fwPath);
+    _exit(127);
+  }
+
+  port.attachFd(ttyFd);
+  return fwPid > 0;
+}
+
+static unsigned long nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+static void sendPacket(byte command, const byte* data, byte len) {
+  sliderPacket pkt = { (sliderCommand)command, (byte*)data, len, true };
+  proto.sendPacket(pkt);
+}
+
+// wait up to timeoutMs for a packet with `command`, dropping everything else (0 to just drain)
+static bool waitFor(byte command, sliderPacket &out, int timeoutMs) {
+  unsigned long start = nowMs();
+
+  while (true) {
+    sliderPacket pkt = proto.getPacket();
+    if (command && pkt.Command == (sliderCommand)command && pkt.IsValid) {
+      out = pkt;
+      return true;
+    }
+    if (pkt.Command != (sliderCommand)0)
+      continue;
+
+    int elapsedMs = nowMs() - start;
+    if (elapsedMs >= timeoutMs)
+      return false;
+
+    struct pollfd pfd = { ttyFd, POLLIN, 0 };
+    poll(&pfd, 1, timeoutMs - elapsedMs);
+  }
+}
+
+// read one probe (resetting it after if `reset`)
+// returns false if the board didn't answer, or the probe doesn't exist
+static bool readProbe(byte probe, bool reset, profileReport &report) {
+  byte request[2] = { probe, reset };
+  sendPacket(SLIDER_PROFILE, request, sizeof(request));
+
+  sliderPacket pkt;
+  if (!waitFor(SLIDER_PROFILE, pkt, RESPONSE_TIMEOUT_MS) || pkt.DataLength < sizeof(profileReport))
+    return false;
+  memcpy(&report, pkt.Data, sizeof(report));
+  return report.bucketCount <= PROFILER_BUCKETS;
+}
+
+// the limit of the bucket that the p'th percentile falls in (0 for the last bucket, which has no limit)
+static unsigned long percentileLimit(const profileReport &report, unsigned long total, double p) {
+  unsigned long rank = (unsigned long)(p / 100.0 * total + 0.5), seen = 0;
+  for (byte b = 0; b < report.bucketCount; b++) {
+    seen += report.counts[b];
+    if (seen >= rank && seen > 0)
+      return (b == report.bucketCount - 1) ? 0 : (1UL << (report.firstBucketLog2 + b));
+  }
+  return 0;
+}
+
+static void printPercentile(const profileReport &report, unsigned long total, double p) {
+  unsigned long limit = percentileLimit(report, total, p);
+  char text[24];
+  if (limit)
+    snprintf(text, sizeof(text), "< %lu", limit);
+  else
+    snprintf(text, sizeof(text), ">= %lu", 1UL << (report.firstBucketLog2 + report.bucketCount - 2));
+  printf("  %10s", text);
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "usage: %s --tty PATH | --fw PATH [--seconds N]\n", name);
+}
+
+int main(int argc, char** argv) {
+  const char* ttyPath = NULL;
+  const char* fwPath = NULL;
+  double seconds = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--tty") == 0 && i + 1 < argc)
+      ttyPath = argv[++i];
+    else if (strcmp(argv[i], "--fw") == 0 && i + 1 < argc)
+      fwPath = argv[++i];
+    else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+      seconds = atof(argv[++i]);
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!ttyPath == !fwPath) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (fwPath ? !startFirmware(fwPath) : !openTty(ttyPath))
+    return 1;
+
+  bool ok = true;
+  profileReport report;
+  if (!readProbe(0, false, report)) {
+    fprintf(stderr, "no profile response (is the firmware built with PROFILER_ENABLED?)\n");
+    ok = false;
+  }
+  byte probeCount = ok ? report.probeCount : 0;
+
+  if (ok && seconds > 0) {
+    // start every probe from empty, then scan like a game would
+    for (byte p = 0; p < probeCount && ok; p++)
+      ok = readProbe(p, true, report);
+
+    sendPacket(SLIDER_SCAN_ON, NULL, 0);
+    unsigned long startMs = nowMs(), lastKeepaliveMs = startMs;
+    sliderPacket pkt;
+    while (nowMs() - startMs < seconds * 1000) {
+      waitFor(0, pkt, 50);
+      if (nowMs() - lastKeepaliveMs >= KEEPALIVE_MS) {
+        sendPacket(SLIDER_DETECT, NULL, 0);
+        lastKeepaliveMs = nowMs();
+      }
+    }
+    sendPacket(SLIDER_SCAN_OFF, NULL, 0);
+    waitFor(SLIDER_SCAN_OFF, pkt, RESPONSE_TIMEOUT_MS);
+  }
+
+  if (ok) {
+    printf("%-9s %8s  %10s  %10s  %10s  %8s   (us)\n", "probe", "count", "p50", "p90", "p99", "max");
+    for (byte p = 0; p < probeCount; p++) {
+      if (!readProbe(p, false, report)) {
+        fprintf(stderr, "no response for probe %d\n", p);
+        ok = false;
+        break;
+      }
+
+      unsigned long total = 0;
+      for (byte b = 0; b < report.bucketCount; b++)
+        total += report.counts[b];
+
+      printf("%-9.*s %8lu", PROFILER_NAME_LEN, report.name, total);
+      if (total == 0) {
+        printf("\n");
+        continue;
+      }
+      printPercentile(report, total, 50);
+      printPercentile(report, total, 90);
+      printPercentile(report, total, 99);
+      printf("  %8u\n", report.maxMicros);
+    }
+  }
+
+  if (fwPid > 0) {
+    kill(fwPid, SIGTERM);
+    waitpid(fwPid, NULL, 0);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,320 @@
+/*
+ * raw electrode stream reader: turns on SlidA's raw data stream (SLIDER_SCAN_07, see rawStream.h) and shows it
+ *
+ *   raw_stream --tty PATH [--seconds N] [--check]
+ *   raw_stream --fw PATH [--seconds N] [--check]
+ *
+ * --tty reads from a board on a serial port, which should be idle apart from this
+ * --fw starts the host firmware build on a pty (with some simulated sensor noise) instead
+ * --check exits with an error unless raw data and baselines arrived without gaps, for automated runs
+ *
+ * prints the packet and byte rates every second, then a table of every electrode:
+ * last filtered data, baseline (as 10 bits), delta (baseline - filtered, which rises with touch)
+ * and the filtered data range seen while running, which is the noise that touch thresholds have to clear
+ */
+
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "segaSlider.h"
+#include "rawStream.h"
+
+// how long to wait for each startup response
+#define STARTUP_TIMEOUT_MS 1000
+
+// send SLIDER_DETECT this often so the firmware doesn't time out and stop scanning
+#define KEEPALIVE_MS 1000
+
+// noise for the simulated sensors with --fw (see mprSim.h)
+#define FW_NOISE "4"
+
+// most chips a board can have (SLIDER_BOARDS_MAX_MPRS)
+#define MAX_CHIPS 8
+
+
+struct electrodeStats {
+  bool seen;
+  uint16_t filtered;
+  uint16_t minFiltered;
+  uint16_t maxFiltered;
+  bool hasBaseline;
+  byte baseline;
+};
+
+static electrodeStats electrodes[MAX_CHIPS][12];
+static byte chipCount = 0;
+
+static int ttyFd = -1;
+static pid_t fwPid = -1;
+static HostSerial port;
+static segaSlider<sliderStreamTransport> proto(&port);
+
+static bool openTty(const char* path) {
+  ttyFd = open(path, O_RDWR | O_NOCTTY);
+  if (ttyFd < 0) {
+    perror(path);
+    return false;
+  }
+
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B115200);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+  tcflush(ttyFd, TCIOFLUSH);
+
+  port.attachFd(ttyFd);
+  return true;
+}
+
+// start slida_fw on a new pty (like trace_dump)
+static bool startFirmware(const char* fwPath) {
+  ttyFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (ttyFd < 0 || grantpt(ttyFd) != 0 || unlockpt(ttyFd) != 0) {
+    perror("pty");
+    return false;
+  }
+  std::string ttyPath = ptsname(ttyFd);
+
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+
+  fwPid = fork();
+  if (fwPid == 0) {
+    close(ttyFd);
+    execl(fwPath, fwPath, "--tty", ttyPath.c_str(), "--noise", FW_NOISE, (char*)NULL);
+    perror(fwPath);
+    _exit(127);
+  }
+
+  port.attachFd(ttyFd);
+  return fwPid > 0;
+}
+
+static unsigned long nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+static void sendPacket(byte command, const byte* data, byte len) {
+  sliderPacket pkt = { (sliderCommand)command, (byte*)data, len, true };
+  proto.sendPacket(pkt);
+}
+
+// wait up to timeoutMs for a packet with `command`, dropping everything else
+static bool waitFor(byte command, sliderPacket &out, int timeoutMs) {
+  unsigned long start = nowMs();
+
+  while (true) {
+    sliderPacket pkt = proto.getPacket();
+    if (pkt.Command == (sliderCommand)command && pkt.IsValid) {
+      out = pkt;
+      return true;
+    }
+    if (pkt.Command != (sliderCommand)0)
+      continue;
+
+    int elapsedMs = nowMs() - start;
+    if (elapsedMs >= timeoutMs)
+      return false;
+
+    struct pollfd pfd = { ttyFd, POLLIN, 0 };
+    poll(&pfd, 1, timeoutMs - elapsedMs);
+  }
+}
+
+static void applyFiltered(const sliderPacket &pkt) {
+  byte first = pkt.Data[1], chips = pkt.Data[2];
+  uint16_t values[12 * RAW_CHIPS_PER_PACKET];
+  rawUnpack10(&pkt.Data[RAW_HEADER_LEN], 12 * chips, values);
+
+  for (byte i = 0; i < 12 * chips; i++) {
+    electrodeStats &e = electrodes[first + i / 12][i % 12];
+    e.filtered = values[i];
+    if (!e.seen || values[i] < e.minFiltered)
+      e.minFiltered = values[i];
+    if (!e.seen || values[i] > e.maxFiltered)
+      e.maxFiltered = values[i];
+    e.seen = true;
+  }
+  if (first + chips > chipCount)
+    chipCount = first + chips;
+}
+
+static void applyBaselines(const sliderPacket &pkt) {
+  byte first = pkt.Data[1], chips = pkt.Data[2];
+  for (byte i = 0; i < 12 * chips; i++) {
+    electrodeStats &e = electrodes[first + i / 12][i % 12];
+    e.baseline = pkt.Data[RAW_HEADER_LEN + i];
+    e.hasBaseline = true;
+  }
+}
+
+static void printElectrodes() {
+  printf("\n  %4s %3s  %8s  %8s  %6s  %13s\n", "chip", "el", "filtered", "baseline", "delta", "filtered range");
+  for (byte chip = 0; chip < chipCount; chip++) {
+    for (byte el = 0; el < 12; el++) {
+      const electrodeStats &e = electrodes[chip][el];
+      if (!e.seen)
+        continue;
+
+      char baseline[8] = "-", delta[8] = "-";
+      if (e.hasBaseline) {
+        snprintf(baseline, sizeof(baseline), "%d", e.baseline << 2);
+        snprintf(delta, sizeof(delta), "%d", (e.baseline << 2) - e.filtered);
+      }
+      printf("  %4d %3d  %8d  %8s  %6s  %4d-%-4d (%d)\n", chip, el, e.filtered, baseline, delta,
+             e.minFiltered, e.maxFiltered, e.maxFiltered - e.minFiltered);
+    }
+  }
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "usage: %s --tty PATH | --fw PATH [--seconds N] [--check]\n", name);
+}
+
+int main(int argc, char** argv) {
+  const char* ttyPath = NULL;
+  const char* fwPath = NULL;
+  double seconds = 5;
+  bool check = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--tty") == 0 && i + 1 < argc)
+      ttyPath = argv[++i];
+    else if (strcmp(argv[i], "--fw") == 0 && i + 1 < argc)
+      fwPath = argv[++i];
+    else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+      seconds = atof(argv[++i]);
+    else if (strcmp(argv[i], "--check") == 0)
+      check = true;
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!ttyPath == !fwPath) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (fwPath ? !startFirmware(fwPath) : !openTty(ttyPath))
+    return 1;
+
+  bool ok = true;
+  sliderPacket pkt;
+  sendPacket(SLIDER_SCAN_ON, NULL, 0);
+  byte on = 1;
+  sendPacket(SLIDER_SCAN_07, &on, 1);
+  if (!waitFor(SLIDER_SCAN_07, pkt, STARTUP_TIMEOUT_MS) || pkt.DataLength < 1 || !pkt.Data[0]) {
+    fprintf(stderr, "the raw stream didn't start (is the firmware built with RAW_STREAM_ENABLED?)\n");
+    ok = false;
+  }
+
+  unsigned long filteredPackets = 0, baselinePackets = 0, scanReports = 0, dataBytes = 0, lostTicks = 0;
+  unsigned long ticks = 0;
+  unsigned long secondPackets = 0, secondBytes = 0, secondTicks = 0;
+  int lastSequence = -1;
+
+  unsigned long startMs = nowMs(), lastSecondMs = startMs, lastKeepaliveMs = startMs;
+  while (ok && nowMs() - startMs < seconds * 1000) {
+    struct pollfd pfd = { ttyFd, POLLIN, 0 };
+    poll(&pfd, 1, 50);
+
+    while (true) {
+      pkt = proto.getPacket();
+      if (pkt.Command == (sliderCommand)0)
+        break;
+      if (!pkt.IsValid)
+        continue;
+
+      switch (pkt.Command) {
+        case SLIDER_REPORT_06:
+          if (pkt.DataLength < RAW_HEADER_LEN || pkt.Data[1] + pkt.Data[2] > MAX_CHIPS ||
+              pkt.DataLength != RAW_HEADER_LEN + RAW_PACKED_LEN(12 * pkt.Data[2]))
+            break;
+          applyFiltered(pkt);
+          filteredPackets++;
+
+          // every packet of a tick has the same sequence, so only count the first
+          if (pkt.Data[0] != lastSequence) {
+            if (lastSequence >= 0)
+              lostTicks += (byte)(pkt.Data[0] - lastSequence - 1);
+            lastSequence = pkt.Data[0];
+            ticks++;
+            secondTicks++;
+          }
+          break;
+
+        case SLIDER_REPORT_0B:
+          if (pkt.DataLength < RAW_HEADER_LEN || pkt.Data[1] + pkt.Data[2] > MAX_CHIPS ||
+              pkt.DataLength != RAW_HEADER_LEN + 12 * pkt.Data[2])
+            break;
+          applyBaselines(pkt);
+          baselinePackets++;
+          break;
+
+        case SLIDER_SCAN_REPORT:
+          scanReports++;
+          break;
+
+        default:
+          break;
+      }
+
+      // framed size on the wire, without escapes: start, command, length, data, checksum
+      dataBytes += 4 + pkt.DataLength;
+      secondBytes += 4 + pkt.DataLength;
+      secondPackets++;
+    }
+
+    if (nowMs() - lastKeepaliveMs > KEEPALIVE_MS) {
+      sendPacket(SLIDER_DETECT, NULL, 0);
+      lastKeepaliveMs = nowMs();
+    }
+
+    if (nowMs() - lastSecondMs >= 1000) {
+      printf("%6lu raw ticks/s  %6lu packets/s  %7lu bytes/s\n", secondTicks, secondPackets, secondBytes);
+      secondTicks = secondPackets = secondBytes = 0;
+      lastSecondMs = nowMs();
+    }
+  }
+
+  if (ok) {
+    sendPacket(SLIDER_SCAN_OFF, NULL, 0);
+    waitFor(SLIDER_SCAN_OFF, pkt, STARTUP_TIMEOUT_MS);
+
+    double runSeconds = (nowMs() - startMs) / 1000.0;
+    printElectrodes();
+    printf("\nraw ticks            %lu (%.0f/s), %lu lost\n", ticks, ticks / runSeconds, lostTicks);
+    printf("packets              %lu filtered data, %lu baselines, %lu scan reports (%.0f/s)\n",
+           filteredPackets, baselinePackets, scanReports, scanReports / runSeconds);
+    printf("received             %.0f bytes/s\n", dataBytes / runSeconds);
+    printf("parser               %lu dropped frames\n", (unsigned long)proto.getDroppedFrames());
+
+    if (check && (ticks == 0 || baselinePackets == 0 || lostTicks > 0)) {
+      fprintf(stderr, "check failed: %s\n", ticks == 0 ? "no raw data" : baselinePackets == 0 ? "no baselines" : "lost raw ticks");
+      ok = false;
+    }
+  }
+
+  if (fwPid > 0) {
+    kill(fwPid, SIGTERM);
+    waitpid(fwPid, NULL, 0);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+/*
+ * shared memory layout for slider_bridge, and the reader/writer side of it
+ *
+ * slider_bridge owns the slider's serial port and publishes into a POSIX shared memory segment
+ * (SLIDER_SHM_NAME, under /dev/shm) that any number of processes can map:
+ *   - the newest scan report, behind a seqlock: the bridge is the only writer, and readers retry if a write
+ *     overlapped their copy, so reading never blocks the bridge or other readers (a read is a ~50 byte copy)
+ *   - LED frames from any number of writers, latest wins: each frame takes a ticket, goes into slot
+ *     ticket % SLIDER_SHM_LED_SLOTS with its own seqlock, and the newest ticket is published.
+ *     the bridge only sends the newest frame, so frames that are overtaken before it gets to them are merged
+ *   - board info and bridge counters
+ *
+ * nothing here takes a lock, so a reader or writer that dies partway can't hold anything up
+ * (a writer that dies mid-frame just leaves a slot that's skipped)
+ */
+
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "segaSlider.h"
+
+#define SLIDER_SHM_NAME "/slida_bridge"
+#define SLIDER_SHM_MAGIC 0x534C4441 // 'SLDA'
+#define SLIDER_SHM_VERSION 2
+
+// max keys in a scan report, and max LED frame data (brightness byte + 32 BRG LEDs)
+#define SLIDER_SHM_MAX_KEYS 32
+#define SLIDER_SHM_MAX_LED_DATA SLIDER_LED_MAX_DATA
+
+// LED frames that can be being written at once before writers start overwriting each other's slots
+#define SLIDER_SHM_LED_SLOTS 8
+
+// give up on a read after this many overlapping writes (only if a writer was killed mid-write)
+#define SLIDER_SHM_READ_RETRIES 100000
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory atomics have to be lock free");
+
+// CLOCK_MONOTONIC in ns, which every process on the machine shares
+static inline uint64_t sliderShmNowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct sliderShmScan {
+  uint64_t receivedNs; // CLOCK_MONOTONIC when the bridge parsed the report
+  uint32_t count; // scan reports received since the bridge started (0 = none yet)
+  byte keyCount;
+  byte keys[SLIDER_SHM_MAX_KEYS]; // as sent by the board (0 or 0xC0, or analog values)
+};
+
+struct sliderShmLedFrame {
+  uint64_t writtenNs; // CLOCK_MONOTONIC when the writer published it
+  byte length;
+  byte data[SLIDER_SHM_MAX_LED_DATA]; // SLIDER_LED packet data
+};
+
+struct sliderShmLedSlot {
+  std::atomic<uint64_t> seq; // 2 * ticket + 1 while being written, 2 * ticket + 2 once written
+  sliderShmLedFrame frame;
+};
+
+struct sliderShm {
+  // set up once by the bridge before magic is set (check magic and version before anything else)
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  uint32_t bridgePid;
+  boardInfo info; // from SLIDER_BOARDINFO when the bridge connected
+
+  // set to 0 when the bridge exits
+  std::atomic<uint32_t> running;
+
+  // scan report seqlock: odd while the bridge is writing scan
+  alignas(64) std::atomic<uint32_t> scanSeq;
+  sliderShmScan scan;
+
+  // LED frames: writers take tickets from ledNextTicket, and ledLatest is the newest fully written ticket + 1
+  alignas(64) std::atomic<uint64_t> ledNextTicket;
+  std::atomic<uint64_t> ledLatest;
+  sliderShmLedSlot ledSlots[SLIDER_SHM_LED_SLOTS];
+
+  // bridge counters (only written by the bridge)
+  alignas(64) std::atomic<uint32_t> ledFramesSent;
+  std::atomic<uint32_t> ledFramesMerged; // overtaken by a newer frame before they were sent
+  std::atomic<uint32_t> ledSendFailures; // couldn't be written to the serial port (or were too long)
+  std::atomic<uint32_t> boardLedPackets; // LED packets the board says it received (from SLIDER_STATS, 0 if it doesn't answer that)
+  std::atomic<uint32_t> droppedFrames; // from segaSlider::getDroppedFrames
+  std::atomic<uint32_t> checksumErrors;
+};
+
+
+// bridge side: publish a scan report
+static inline void sliderShmWriteScan(sliderShm* shm, const byte* keys, byte keyCount, uint64_t receivedNs) {
+  if (keyCount > SLIDER_SHM_MAX_KEYS)
+    keyCount = SLIDER_SHM_MAX_KEYS;
+
+  uint32_t seq = shm->scanSeq.load(std::memory_order_relaxed);
+  shm->scanSeq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  shm->scan.receivedNs = receivedNs;
+  shm->scan.count++;
+  shm->scan.keyCount = keyCount;
+  memcpy(shm->scan.keys, keys, keyCount);
+
+  shm->scanSeq.store(seq + 2, std::memory_order_release);
+}
+
+// reader side: copy the newest scan report
+// returns false if there hasn't been one yet
+static inline bool sliderShmReadScan(const sliderShm* shm, sliderShmScan &out) {
+  for (unsigned long retries = 0; retries < SLIDER_SHM_READ_RETRIES; retries++) {
+    uint32_t before = shm->scanSeq.load(std::memory_order_acquire);
+    if (before & 1)
+      continue; // the bridge is writing
+
+    memcpy(&out, &shm->scan, sizeof(out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (shm->scanSeq.load(std::memory_order_relaxed) == before)
+      return out.count != 0;
+  }
+  return false;
+}
+
+// writer side: queue an LED frame (SLIDER_LED packet data), replacing any that haven't been sent yet
+static inline void sliderShmWriteLed(sliderShm* shm, const byte* data, byte length) {
+  if (length > SLIDER_SHM_MAX_LED_DATA)
+    length = SLIDER_SHM_MAX_LED_DATA;
+
+  uint64_t ticket = shm->ledNextTicket.fetch_add(1, std::memory_order_relaxed);
+  sliderShmLedSlot &slot = shm->ledSlots[ticket % SLIDER_SHM_LED_SLOTS];
+
+  slot.seq.store(2 * ticket + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.frame.writtenNs = sliderShmNowNs();
+  slot.frame.length = length;
+  memcpy(slot.frame.data, data, length);
+
+  slot.seq.store(2 * ticket + 2, std::memory_order_release);
+
+  // publish, unless a newer frame already has been
+  uint64_t latest = shm->ledLatest.load(std::memory_order_relaxed);
+  while (latest < ticket + 1 &&
+         !shm->ledLatest.compare_exchange_weak(latest, ticket + 1, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+// bridge side: copy the newest LED frame if it's newer than `after` (a ticket + 1, 0 for any)
+// returns the frame's ticket + 1, or 0 if there's nothing newer
+static inline uint64_t sliderShmReadLed(const sliderShm* shm, uint64_t after, sliderShmLedFrame &out) {
+  while (true) {
+    uint64_t latest = shm->ledLatest.load(std::memory_order_acquire);
+    if (latest <= after)
+      return 0;
+
+    const sliderShmLedSlot &slot = shm->ledSlots[(latest - 1) % SLIDER_SHM_LED_SLOTS];
+    uint64_t expected = 2 * (latest - 1) + 2;
+    if (slot.seq.load(std::memory_order_acquire) != expected)
+      return 0; // reused by a newer writer, which will publish a newer ticket when it's done
+
+    memcpy(&out, &slot.frame, sizeof(out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (slot.seq.load(std::memory_order_relaxed) == expected)
+      return latest;
+  }
+}
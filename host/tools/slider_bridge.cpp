@@ -0,0 +1,315 @@
+/*
+ * slider bridge daemon: owns the slider's serial port and shares it through shared memory (see sliderShm.h)
+ *
+ *   slider_bridge --tty PATH [--shm NAME] [--seconds N]
+ *   slider_bridge --fw PATH [--shm NAME] [--seconds N]
+ *
+ * --tty connects to a board on a serial port
+ * --fw starts the host firmware build on a pty instead, as a stand-in for the board
+ * --shm sets the shared memory name (default SLIDER_SHM_NAME)
+ * --seconds exits after N seconds (default: run until SIGINT/SIGTERM)
+ *
+ * on startup it reads the board info and turns scanning on, then:
+ *   - every scan report is published with its receive time, for readers to pick up with sliderShmReadScan
+ *   - the newest LED frame from sliderShmWriteLed is sent whenever there's a new one (older unsent ones are dropped)
+ *   - SLIDER_STATS is sent every STATS_MS, which publishes how many LED packets actually reached the board,
+ *     and keeps it from timing out without LED writers
+ * other commands aren't forwarded, so games have to go through a hook that uses the shared memory
+ */
+
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "segaSlider.h"
+#include "sliderShm.h"
+
+// how long to wait for each startup response
+#define STARTUP_TIMEOUT_MS 1000
+
+// longest wait for serial data before checking for LED frames again
+// (LED writers don't wake the bridge, so this is the most an LED frame waits before being sent)
+#define LED_CHECK_US 250
+
+// read the board's receive statistics this often (the firmware turns scanning off after 10s without any packets)
+#define STATS_MS 250
+
+
+static int ttyFd = -1;
+static pid_t fwPid = -1;
+static HostSerial port;
+static segaSlider<sliderStreamTransport> proto(&port);
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+  stopRequested = 1;
+}
+
+static bool openTty(const char* path) {
+  ttyFd = open(path, O_RDWR | O_NOCTTY);
+  if (ttyFd < 0) {
+    perror(path);
+    return false;
+  }
+
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B115200);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+  tcflush(ttyFd, TCIOFLUSH);
+
+  port.attachFd(ttyFd);
+  return true;
+}
+
+// start slida_fw on a new pty (like trace_dump)
+static bool startFirmware(const char* fwPath) {
+  ttyFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (ttyFd < 0 || grantpt(ttyFd) != 0 || unlockpt(ttyFd) != 0) {
+    perror("pty");
+    return false;
+  }
+  std::string ttyPath = ptsname(ttyFd);
+
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+
+  fwPid = fork();
+  if (fwPid == 0) {
+    close(ttyFd);
+    execl(fwPath, fwPath, "--tty", ttyPath.c_str(), (char*)NULL);
+    perror(fwPath);
+    _exit(127);
+  }
+
+  port.attachFd(ttyFd);
+  return fwPid > 0;
+}
+
+// create and map the shared memory segment, with everything zeroed
+static sliderShm* createShm(const char* name) {
+  shm_unlink(name); // start fresh if an old bridge didn't clean up
+
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+  if (fd < 0) {
+    perror("shm_open");
+    return NULL;
+  }
+  fchmod(fd, 0666); // readers and LED writers don't have to run as the same user (umask would stop that)
+
+  if (ftruncate(fd, sizeof(sliderShm)) != 0) {
+    perror("ftruncate");
+    close(fd);
+    return NULL;
+  }
+
+  void* mem = mmap(NULL, sizeof(sliderShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    perror("mmap");
+    return NULL;
+  }
+
+  return (sliderShm*)mem; // new segments are zero filled, which is a valid empty state for every field
+}
+
+static unsigned long nowMs() {
+  return sliderShmNowNs() / 1000000;
+}
+
+static void sendPacket(byte command, const byte* data, byte len) {
+  sliderPacket pkt = { (sliderCommand)command, (byte*)data, len, true };
+  proto.sendPacket(pkt);
+}
+
+// send an LED frame
+// segaSlider::sendPacket only takes packets as big as the ones the board sends, so LED frames are encoded here
+// returns false if it was too long or couldn't be written
+static bool sendLedFrame(const sliderShmLedFrame &frame) {
+  if (frame.length > SLIDER_LED_MAX_DATA)
+    return false;
+
+  sliderPacket pkt = { SLIDER_LED, frame.data, frame.length, true };
+  byte encoded[SLIDER_FRAME_MAX_SIZE(SLIDER_LED_MAX_DATA)];
+  byte len = sliderEncodeFrame(pkt, encoded);
+  return port.write(encoded, len) == len;
+}
+
+// wait up to timeoutMs for a packet with `command`, dropping everything else
+static bool waitFor(byte command, sliderPacket &out, int timeoutMs) {
+  unsigned long start = nowMs();
+
+  while (!stopRequested) {
+    sliderPacket pkt = proto.getPacket();
+    if (pkt.Command == (sliderCommand)command && pkt.IsValid) {
+      out = pkt;
+      return true;
+    }
+    if (pkt.Command != (sliderCommand)0)
+      continue;
+
+    int elapsedMs = nowMs() - start;
+    if (elapsedMs >= timeoutMs)
+      return false;
+
+    struct pollfd pfd = { ttyFd, POLLIN, 0 };
+    poll(&pfd, 1, timeoutMs - elapsedMs);
+  }
+  return false;
+}
+
+// get the board info and start scanning, like a game does
+static bool connectBoard(sliderShm* shm) {
+  sliderPacket pkt;
+  sendPacket(SLIDER_DETECT, NULL, 0);
+  waitFor(SLIDER_DETECT, pkt, STARTUP_TIMEOUT_MS); // older firmware doesn't answer this
+
+  sendPacket(SLIDER_BOARDINFO, NULL, 0);
+  if (!waitFor(SLIDER_BOARDINFO, pkt, STARTUP_TIMEOUT_MS) || pkt.DataLength < sizeof(boardInfo)) {
+    fprintf(stderr, "no board info from the slider\n");
+    return false;
+  }
+  memcpy(&shm->info, pkt.Data, sizeof(boardInfo));
+
+  sendPacket(SLIDER_SCAN_ON, NULL, 0);
+  return true;
+}
+
+// handle everything waiting on the serial port
+static void receivePackets(sliderShm* shm) {
+  while (true) {
+    sliderPacket pkt = proto.getPacket();
+    if (pkt.Command == (sliderCommand)0)
+      break;
+
+    if (!pkt.IsValid) {
+      shm->checksumErrors.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    if (pkt.Command == SLIDER_SCAN_REPORT)
+      sliderShmWriteScan(shm, pkt.Data, pkt.DataLength, sliderShmNowNs());
+    else if (pkt.Command == SLIDER_STATS && pkt.DataLength >= sizeof(sliderRxStats)) {
+      sliderRxStats stats;
+      memcpy(&stats, pkt.Data, sizeof(stats));
+      shm->boardLedPackets.store(stats.ledPackets, std::memory_order_relaxed);
+    }
+    // anything else is a response to the bridge's own commands
+  }
+
+  shm->droppedFrames.store(proto.getDroppedFrames(), std::memory_order_relaxed);
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "usage: %s --tty PATH | --fw PATH [--shm NAME] [--seconds N]\n", name);
+}
+
+int main(int argc, char** argv) {
+  const char* ttyPath = NULL;
+  const char* fwPath = NULL;
+  const char* shmName = SLIDER_SHM_NAME;
+  double seconds = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--tty") == 0 && i + 1 < argc)
+      ttyPath = argv[++i];
+    else if (strcmp(argv[i], "--fw") == 0 && i + 1 < argc)
+      fwPath = argv[++i];
+    else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc)
+      shmName = argv[++i];
+    else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+      seconds = atof(argv[++i]);
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!ttyPath == !fwPath) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  if (fwPath ? !startFirmware(fwPath) : !openTty(ttyPath))
+    return 1;
+
+  sliderShm* shm = createShm(shmName);
+  if (!shm)
+    return 1;
+
+  bool ok = connectBoard(shm);
+  if (ok) {
+    shm->version = SLIDER_SHM_VERSION;
+    shm->bridgePid = getpid();
+    shm->running.store(1, std::memory_order_relaxed);
+    shm->magic.store(SLIDER_SHM_MAGIC, std::memory_order_release);
+
+    fprintf(stderr, "bridging %.8s (%.5s) on %s\n", shm->info.model, shm->info.chipNumber, shmName);
+
+    unsigned long startMs = nowMs(), lastStatsMs = 0;
+    uint64_t ledSent = 0; // ticket + 1 of the last LED frame sent
+    sliderShmLedFrame frame;
+
+    while (!stopRequested && (seconds <= 0 || nowMs() - startMs < seconds * 1000)) {
+      struct pollfd pfd = { ttyFd, POLLIN, 0 };
+      struct timespec timeout = { 0, LED_CHECK_US * 1000L };
+      ppoll(&pfd, 1, &timeout, NULL);
+      if (pfd.revents & (POLLHUP | POLLERR)) {
+        fprintf(stderr, "serial port closed\n");
+        ok = false;
+        break;
+      }
+
+      receivePackets(shm);
+
+      uint64_t ticket = sliderShmReadLed(shm, ledSent, frame);
+      if (ticket) {
+        if (sendLedFrame(frame))
+          shm->ledFramesSent.fetch_add(1, std::memory_order_relaxed);
+        else
+          shm->ledSendFailures.fetch_add(1, std::memory_order_relaxed);
+        shm->ledFramesMerged.fetch_add(ticket - ledSent - 1, std::memory_order_relaxed);
+        ledSent = ticket;
+      }
+
+      if (nowMs() - lastStatsMs >= STATS_MS) {
+        sendPacket(SLIDER_STATS, NULL, 0);
+        lastStatsMs = nowMs();
+      }
+    }
+
+    sendPacket(SLIDER_SCAN_OFF, NULL, 0);
+    fprintf(stderr, "%u scans, %u LED frames sent (%u merged, %u send failures, %u received by the board), "
+            "%u checksum errors, %u dropped frames\n",
+            shm->scan.count, shm->ledFramesSent.load(), shm->ledFramesMerged.load(), shm->ledSendFailures.load(),
+            shm->boardLedPackets.load(), shm->checksumErrors.load(), shm->droppedFrames.load());
+  }
+
+  // readers that still have it mapped see running go to 0, and the name is free for the next bridge
+  shm->running.store(0, std::memory_order_release);
+  shm_unlink(shmName);
+
+  if (fwPid > 0) {
+    kill(fwPid, SIGTERM);
+    waitpid(fwPid, NULL, 0);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,332 @@
+/*
+ * protocol trace decoder: reads SlidA's trace ring buffer with SLIDER_TRACE and prints it as a timeline
+ *
+ *   trace_dump --tty PATH
+ *   trace_dump --fw PATH
+ *
+ * --tty reads from a board (or anything else) on a serial port, which should be idle apart from this
+ * --fw starts the host firmware build on a pty and plays a short session against it first
+ * (startup, some scanning, a corrupted frame and an LED frame), which is mostly useful for trying this out
+ *
+ * times are relative to the first record, and deltas that hit the record's limit are shown as lower bounds
+ * the board's receive statistics (SLIDER_STATS) are printed after the trace
+ */
+
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "segaSlider.h"
+#include "sliderTrace.h"
+
+// pages of the dump have to arrive within this long
+#define PAGE_TIMEOUT_MS 1000
+
+
+// same bits as errorState in SlidA.ino
+static const char* const errorNames[8] = {
+  "serial_timeout", "checksum", "packet_ok", "max_packets", "send_failure", "mpr_stopped", "i2c_failure", "bit7"
+};
+
+static const char* eventName(byte event) {
+  switch (event & TRACE_EVENT_MASK) {
+    case TRACE_RX: return "rx";
+    case TRACE_TX: return "tx";
+    case TRACE_SCAN_ON: return "scan on";
+    case TRACE_SCAN_OFF: return "scan off";
+    case TRACE_SERIAL_TIMEOUT: return "timeout";
+    default: return "?";
+  }
+}
+
+static const char* commandName(byte command) {
+  switch (command) {
+    case SLIDER_SCAN_REPORT: return "scan_report";
+    case SLIDER_LED: return "led";
+    case SLIDER_SCAN_ON: return "scan_on";
+    case SLIDER_SCAN_OFF: return "scan_off";
+    case SLIDER_REPORT_06: return "report_06";
+    case SLIDER_SCAN_07: return "scan_07";
+    case SLIDER_UNKNOWN_09: return "unknown_09";
+    case SLIDER_UNKNOWN_0A: return "unknown_0a";
+    case SLIDER_REPORT_0B: return "report_0b";
+    case SLIDER_SCAN_0C: return "scan_0c";
+    case SLIDER_DETECT: return "detect";
+    case SLIDER_PROFILE: return "profile";
+    case SLIDER_SET_PROFILE: return "set_profile";
+    case SLIDER_CALIBRATE: return "calibrate";
+    case SLIDER_TRACE: return "trace";
+    case SLIDER_LOADGEN: return "loadgen";
+    case SLIDER_STATS: return "stats";
+    case SLIDER_EXCEPTION: return "exception";
+    case SLIDER_BOARDINFO: return "boardinfo";
+    default: return NULL;
+  }
+}
+
+
+static int ttyFd = -1;
+static pid_t fwPid = -1;
+static HostSerial port;
+static segaSlider<sliderStreamTransport> proto(&port);
+
+static bool openTty(const char* path) {
+  ttyFd = open(path, O_RDWR | O_NOCTTY);
+  if (ttyFd < 0) {
+    perror(path);
+    return false;
+  }
+
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B115200);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+  tcflush(ttyFd, TCIOFLUSH);
+
+  port.attachFd(ttyFd);
+  return true;
+}
+
+// start slida_fw on a new pty (like latency_harness, but without the control socket)
+static bool startFirmware(const char* fwPath) {
+  ttyFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (ttyFd < 0 || grantpt(ttyFd) != 0 || unlockpt(ttyFd) != 0) {
+    perror("pty");
+    return false;
+  }
+  std::string ttyPath = ptsname(ttyFd);
+
+  struct termios tio;
+  if (tcgetattr(ttyFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(ttyFd, TCSANOW, &tio);
+  }
+
+  fwPid = fork();
+  if (fwPid == 0) {
+    close(ttyFd);
+    execl(fwPath, fwPath, "--tty", ttyPath.c_str(), (char*)NULL);
+    perror(fwPath);
+    _exit(127);
+  }
+
+  port.attachFd(ttyFd);
+  return fwPid > 0;
+}
+
+static void sendPacket(byte command, const byte* data, byte len) {
+  sliderPacket pkt = { (sliderCommand)command, (byte*)data, len, true };
+  proto.sendPacket(pkt);
+}
+
+// wait up to timeoutMs for a packet with `command`, dropping everything else (command 0 just waits)
+static bool waitFor(byte command, sliderPacket &out, int timeoutMs) {
+  struct timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (true) {
+    sliderPacket pkt = proto.getPacket();
+    if (command != 0 && pkt.Command == (sliderCommand)command && pkt.IsValid) {
+      out = pkt;
+      return true;
+    }
+    if (pkt.Command != (sliderCommand)0)
+      continue;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int elapsedMs = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+    if (elapsedMs >= timeoutMs)
+      return false;
+
+    struct pollfd pfd = { ttyFd, POLLIN, 0 };
+    poll(&pfd, 1, timeoutMs - elapsedMs);
+  }
+}
+
+// read (and drop) whatever arrives for ms
+static void drain(int ms) {
+  sliderPacket pkt;
+  waitFor(0, pkt, ms);
+}
+
+// a short session to give the trace something to show
+static void playSession() {
+  sliderPacket pkt;
+  sendPacket(SLIDER_DETECT, NULL, 0);
+  waitFor(SLIDER_DETECT, pkt, PAGE_TIMEOUT_MS);
+  sendPacket(SLIDER_BOARDINFO, NULL, 0);
+  waitFor(SLIDER_BOARDINFO, pkt, PAGE_TIMEOUT_MS);
+
+  sendPacket(SLIDER_SCAN_ON, NULL, 0);
+  drain(20);
+
+  // an LED packet with its checksum broken
+  const byte badFrame[] = { SLIDER_FRAMING_START, SLIDER_LED, 4, 0x3F, 0x10, 0x20, 0x30, 0x00 };
+  port.write(badFrame, sizeof(badFrame));
+  drain(5);
+
+  sendPacket(SLIDER_SCAN_OFF, NULL, 0);
+  waitFor(SLIDER_SCAN_OFF, pkt, PAGE_TIMEOUT_MS);
+
+  const byte led[] = { 0x3F, 0x10, 0x20, 0x30 };
+  sendPacket(SLIDER_LED, led, sizeof(led));
+  drain(5);
+}
+
+// read every page of the trace
+// returns false if the board didn't answer properly
+static bool readTrace(std::vector<traceRecord> &records, byte &tickLog2) {
+  byte count = 0;
+  byte offset = 0;
+  do {
+    sendPacket(SLIDER_TRACE, &offset, 1);
+
+    sliderPacket pkt;
+    if (!waitFor(SLIDER_TRACE, pkt, PAGE_TIMEOUT_MS)) {
+      fprintf(stderr, "no trace response (is the firmware built with TRACE_ENABLED?)\n");
+      return false;
+    }
+    if (pkt.DataLength < 3 || pkt.Data[1] != offset || (pkt.DataLength - 3) % sizeof(traceRecord) != 0) {
+      fprintf(stderr, "bad trace response (length %d)\n", pkt.DataLength);
+      return false;
+    }
+
+    count = pkt.Data[0];
+    tickLog2 = pkt.Data[2];
+    size_t n = (pkt.DataLength - 3) / sizeof(traceRecord);
+    for (size_t i = 0; i < n; i++) {
+      traceRecord r;
+      memcpy(&r, &pkt.Data[3 + i * sizeof(traceRecord)], sizeof(r));
+      records.push_back(r);
+    }
+
+    if (n == 0)
+      break;
+    offset += n;
+  } while (offset < count);
+
+  return true;
+}
+
+static void printTrace(const std::vector<traceRecord> &records, byte tickLog2) {
+  printf("%zu records, %d us ticks\n\n", records.size(), 1 << tickLog2);
+  printf("  %12s  %11s  %-9s %-14s %4s  %-4s %s\n", "time ms", "delta ms", "event", "command", "len", "ok", "errors");
+
+  double timeMs = 0;
+  for (size_t i = 0; i < records.size(); i++) {
+    const traceRecord &r = records[i];
+    double deltaMs = (double)((unsigned long)r.ticks << tickLog2) / 1000;
+    bool saturated = r.ticks == 0xFFFF;
+    if (i > 0) // the first record's delta is from before the trace
+      timeMs += deltaMs;
+
+    char delta[16];
+    snprintf(delta, sizeof(delta), "%s%.3f", saturated ? ">" : "", deltaMs);
+
+    byte type = r.event & TRACE_EVENT_MASK;
+    bool isPacket = type == TRACE_RX || type == TRACE_TX;
+
+    char command[16] = "";
+    if (isPacket) {
+      const char* name = commandName(r.command);
+      if (name)
+        snprintf(command, sizeof(command), "%s", name);
+      else
+        snprintf(command, sizeof(command), "0x%02X", r.command);
+    }
+
+    std::string errors;
+    for (byte bit = 0; bit < 8; bit++) {
+      if (r.errors & (1 << bit)) {
+        if (!errors.empty())
+          errors += ",";
+        errors += errorNames[bit];
+      }
+    }
+
+    char length[8] = "";
+    if (isPacket)
+      snprintf(length, sizeof(length), "%d", r.length);
+
+    printf("  %12.3f  %11s  %-9s %-14s %4s  %-4s %s\n",
+           timeMs, delta, eventName(r.event), command, length,
+           isPacket ? ((r.event & TRACE_FLAG_OK) ? "ok" : "FAIL") : "", errors.c_str());
+  }
+}
+
+// read and print the receive statistics
+// returns false if the board didn't answer properly
+static bool printRxStats() {
+  sendPacket(SLIDER_STATS, NULL, 0);
+
+  sliderPacket pkt;
+  if (!waitFor(SLIDER_STATS, pkt, PAGE_TIMEOUT_MS) || pkt.DataLength < sizeof(sliderRxStats)) {
+    fprintf(stderr, "no stats response\n");
+    return false;
+  }
+  sliderRxStats stats;
+  memcpy(&stats, pkt.Data, sizeof(stats));
+
+  printf("\nreceived             %lu dropped frames, %lu bad checksums, %lu LED packets (%lu merged into newer ones)\n",
+         (unsigned long)stats.framesDropped, (unsigned long)stats.packetsInvalid, (unsigned long)stats.ledPackets,
+         (unsigned long)stats.ledPacketsCoalesced);
+  return true;
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "usage: %s --tty PATH | --fw PATH\n", name);
+}
+
+int main(int argc, char** argv) {
+  const char* ttyPath = NULL;
+  const char* fwPath = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--tty") == 0 && i + 1 < argc)
+      ttyPath = argv[++i];
+    else if (strcmp(argv[i], "--fw") == 0 && i + 1 < argc)
+      fwPath = argv[++i];
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!ttyPath == !fwPath) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (fwPath) {
+    if (!startFirmware(fwPath))
+      return 1;
+    playSession();
+  }
+  else if (!openTty(ttyPath)) {
+    return 1;
+  }
+
+  std::vector<traceRecord> records;
+  byte tickLog2 = TRACE_TICK_LOG2;
+  bool ok = readTrace(records, tickLog2);
+  if (ok) {
+    printTrace(records, tickLog2);
+    ok = printRxStats();
+  }
+
+  if (fwPid > 0) {
+    kill(fwPid, SIGTERM);
+    waitpid(fwPid, NULL, 0);
+  }
+  return ok ? 0 : 1;
+}
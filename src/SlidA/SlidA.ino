@@ -1,14 +1,25 @@
 #include "segaSlider.h"
 #include "sliderdefs.h"
 #include "pins.h"
+#include "taskScheduler.h"
 #include <QuickMpr121.h>
+#include <Wire.h>
+#include "mprRegs.h"
+#include "twiAsync.h"
+#include "profiler.h"
+#include "mprCalibration.h"
+#include <EEPROM.h>
+#include "sliderTrace.h"
+#include "rawStream.h"
+#include "loadGen.h"
 
 #if SLIDER_LEDS
   #include <FastLED.h>
 #endif
 
 #if BUTTON_INPUT
-  #include <Keyboard.h>
+  #include "nkroKeyboard.h"
+  #include "buttonCapture.h"
 #endif
 
 
@@ -32,6 +43,54 @@
 #endif
 
 
+// keep latency histograms of the main parts of the loop, which can be read with SLIDER_PROFILE
+// (costs a couple of micros() calls per probe, turn this off to get them back)
+#define PROFILER_ENABLED true
+
+#if PROFILER_ENABLED
+  enum profilerProbe : byte {
+    PROBE_LOOP, // time between loop() calls
+    PROBE_SERIAL, // serialTask (receiving and handling packets)
+    PROBE_PARSE, // getPacket calls that returned a packet
+    PROBE_LED_SHOW, // pushing data to the LED strip
+    PROBE_I2C_SCAN, // reading the mprs (blocking, or start to finish for background reads)
+    PROBE_SEND, // sending a slider scan
+    PROBE_REPORT, // slider scan started (eg. IRQ seen) until the report is sent
+    PROBE_BUTTON, // button edge captured until its HID report is sent
+    PROBE_SOFT_I2C, // reading the mprs on the soft I2C bus (the hw bus is read at the same time)
+    NUM_PROBES
+  };
+
+  // names for the readout, padded to PROFILER_NAME_LEN
+  const char probeNames[NUM_PROBES][PROFILER_NAME_LEN + 1] PROGMEM = {
+    "loop    ",
+    "serial  ",
+    "parse   ",
+    "ledshow ",
+    "i2cscan ",
+    "send    ",
+    "report  ",
+    "button  ",
+    "softi2c ",
+  };
+
+  latencyHistogram probes[NUM_PROBES];
+
+  #define PROBE_START(probe) probes[probe].start()
+  #define PROBE_STOP(probe) probes[probe].stop()
+  #define PROBE_RECORD(probe, us) probes[probe].record(us)
+#else // PROFILER_ENABLED
+  #define PROBE_START(probe)
+  #define PROBE_STOP(probe)
+  #define PROBE_RECORD(probe, us)
+#endif // PROFILER_ENABLED
+
+
+// board profile in use (points into sliderProfiles, in PROGMEM)
+const sliderProfile* curProfile;
+byte curProfileIndex;
+
+
 #if SLIDER_LEDS
   // slider LED vars
   #define NUM_SLIDER_LEDS 32
@@ -42,6 +101,74 @@
   #define RGB_POWER_LIMIT 450
   
   #define MODE_LED_RGB_INDEX NUM_SLIDER_LEDS-1
+
+  // brightness requested by the host (before power limiting)
+  byte ledBrightness = RGB_BRIGHTNESS;
+
+  // set when sliderLeds or ledBrightness differ from what was last shown
+  bool ledUpdate = false;
+  unsigned long ledUpdateMicros; // when ledUpdate was set
+
+  // flag that sliderLeds or ledBrightness changed (noting when, if it's the first change since the last show)
+  void setLedUpdate() {
+    if (!ledUpdate) {
+      ledUpdate = true;
+      ledUpdateMicros = micros();
+    }
+  }
+
+  // newest SLIDER_LED packet data from the current serial pass
+  // LED packets are only applied once all received packets have been handled, so a burst of them costs one apply
+  // (or before anything that changes the LED plan, so a frame is always drawn with the plan it was sent for)
+  #define LED_PACKET_MAX_LENGTH (1 + 3 * SLIDER_BOARDS_MAX_LEDS) // brightness byte followed by BRG data
+  byte pendingLedData[LED_PACKET_MAX_LENGTH];
+  byte pendingLedLength = 0; // 0 if nothing is pending
+
+  // apply SLIDER_LED packet data to sliderLeds
+  // only flags an update if the frame is actually different from what's there
+  void applyLedPacket(const byte* data, byte dataLength) {
+    if (dataLength == 0)
+      return;
+    
+    byte brightness = (data[0] & 0x3f) * RGB_BRIGHTNESS / 0x3f; // this seems to max out at 0x3f (63), use that for division
+    if (brightness != ledBrightness) {
+      ledBrightness = brightness;
+      setLedUpdate();
+    }
+
+    byte maxPacketLeds = (dataLength - 1) / 3; // subtract 1 because of brightness byte
+    const byte* ledData = &data[1]; // start with + 1 because of brightness byte
+    const byte* ledPlan = curProfile->ledPlan;
+    byte ledCount = pgm_read_byte(&curProfile->ledCount);
+    
+    for (byte i = 0; i < ledCount; i++, ledData += 3) {
+      byte plan = pgm_read_byte(&ledPlan[i]);
+      if (plan == LED_PLAN_NONE)
+        continue;
+
+      CRGB colour = CRGB::Black;
+      if (i < maxPacketLeds) {
+        byte shift = (plan & LED_PLAN_DIM) ? 1 : 0;
+        colour.b = ledData[0] >> shift;
+        colour.r = ledData[1] >> shift;
+        colour.g = ledData[2] >> shift;
+      }
+
+      CRGB &outputLed = sliderLeds[plan & ~LED_PLAN_DIM];
+      if (outputLed != colour) {
+        outputLed = colour;
+        setLedUpdate();
+      }
+    }
+  }
+
+  // apply the newest SLIDER_LED packet received so far, if it hasn't been yet
+  void applyPendingLedPacket() {
+    if (pendingLedLength > 0) {
+      applyLedPacket(pendingLedData, pendingLedLength);
+      pendingLedLength = 0;
+    }
+  }
 #endif // SLIDER_LEDS
 
 
@@ -54,6 +181,7 @@ enum errorState : byte {
   ERRORSTATE_PACKET_MAX_REACHED = 8, // number of packets exceeded MAX_PACKETS_PER_LOOP
   ERRORSTATE_SERIAL_SEND_FAILURE = 16, // sendPacket returned false
   ERRORSTATE_MPR_STOPPED = 32, // an mpr121 stopped running
+  ERRORSTATE_I2C_FAILURE = 64, // a background mpr121 read failed
 };
 errorState operator |(errorState a, errorState b)
 {
@@ -67,6 +195,18 @@ errorState operator |=(errorState &a, errorState b)
 errorState curError;
 
 
+// keep a trace of recent protocol activity, which can be read with SLIDER_TRACE
+// (costs a micros() call per packet, turn this off to get it back)
+#define TRACE_ENABLED true
+
+#if TRACE_ENABLED
+  sliderTrace protocolTrace;
+  #define TRACE(event, command, length) protocolTrace.record(event, command, length, curError)
+#else // TRACE_ENABLED
+  #define TRACE(event, command, length)
+#endif // TRACE_ENABLED
+
+
 // status/error LED pins
 #ifdef LED_BUILTIN_RX
   #define STATUS_LED_BASIC_1_PIN LED_BUILTIN_RX // pro micro has no LED_BUILTIN, so use the RX led
@@ -82,12 +222,25 @@ errorState curError;
   #define STATUS_LED_BASIC_2_PIN LED_BUILTIN
 #endif
 
-#define STATUS_LED_BASIC_1_ERRORS (ERRORSTATE_SERIAL_TIMEOUT | ERRORSTATE_PACKET_CHECKSUM | /*ERRORSTATE_PACKET_MAX_REACHED |*/ ERRORSTATE_SERIAL_SEND_FAILURE | ERRORSTATE_MPR_STOPPED)
+#define STATUS_LED_BASIC_1_ERRORS (ERRORSTATE_SERIAL_TIMEOUT | ERRORSTATE_PACKET_CHECKSUM | /*ERRORSTATE_PACKET_MAX_REACHED |*/ ERRORSTATE_SERIAL_SEND_FAILURE | ERRORSTATE_MPR_STOPPED | ERRORSTATE_I2C_FAILURE)
 #define STATUS_LED_BASIC_2_ERRORS (ERRORSTATE_PACKET_OK)
 
 
 // slider serial protocol implementation
-segaSlider sliderProtocol = segaSlider(&Serial);
+// the transport and codec are picked here (see sliderTransport.h and segaSlider.h), eg.
+//   segaSlider<sliderEndpointTransport> reads straight from the USB CDC endpoint (32u4 only)
+//   segaSlider<sliderSerialTransport, sliderTextCodec> is for testing in a serial console (see slider_text_cmds.txt)
+//   segaSlider<sliderStreamTransport> sliderProtocol(&Serial1) uses a hardware serial port instead of USB
+segaSlider<sliderSerialTransport> sliderProtocol(&Serial);
+
+// send a packet, noting any failure in curError
+bool sendSliderPacket(const sliderPacket &pkt) {
+  bool ok = sliderProtocol.sendPacket(pkt);
+  if (!ok)
+    curError |= ERRORSTATE_SERIAL_SEND_FAILURE;
+  TRACE(ok ? (TRACE_TX | TRACE_FLAG_OK) : TRACE_TX, pkt.Command, pkt.DataLength);
+  return ok;
+}
 
 
 // slider protocol packets for reuse
@@ -102,21 +255,277 @@ sliderPacket boardinfoPacket = { SLIDER_BOARDINFO, (byte*)&boardInfoData, sizeof
 
 
 // mpr121s
+// the first 4 (one per address strap) are on the hw I2C bus and started by QuickMpr121,
+// any more go on a software I2C bus (PIN_SOFT_SDA/PIN_SOFT_SCL, see softI2c.h), up to 8 in total
+//
+// scan reads of soft bus chips are clocked by the CPU while the hw bus reads run in the background (see startSliderRead),
+// so a scan takes about as long as the slower bus, rather than every chip one after another
+//
+// these are ESTIMATES worked out from bit times, not measured on a board:
+//   hw bus (400kHz, ~2.5us/bit):  ~115us/chip touch state only, ~0.70ms/chip analog
+//   soft bus (~7us/bit, ~140kHz): ~0.35ms/chip, ~2.0ms/chip analog
+//     each half clock is the hw bus poll (~1us: a couple of register reads, twiAsync only reads the clock after
+//     TWI_ASYNC_CLOCK_CHECK_POLLS busy polls), SOFT_I2C_HALF_BIT_US and the pin access
+//
+//   mprs (hw+soft)   touch state   analog
+//   3 (3+0)          0.35ms        2.1ms
+//   4 (4+0)          0.46ms        2.8ms
+//   5 (4+1)          0.46ms        2.8ms
+//   6 (4+2)          0.70ms        4.0ms     <- enough for both chunithm rows (chuniSliderTwoRow)
+//   7 (4+3)          1.05ms        6.0ms
+//   8 (4+4)          1.40ms        8.0ms
+// so up to 5 chips the soft bus is hidden behind the hw bus, but past that each soft bus chip adds ~3x what a hw one would
+// (all 8 on one 400kHz bus would be 0.92ms and 5.6ms, if there were enough addresses)
+// blocking scans (keepalives, or without SCAN_ASYNC) read every chip in turn
+//
+// to measure the real times for a chip count, build with that NUM_MPRS and run host/build/profile_dump --tty PATH --seconds 10,
+// which prints the i2cscan (whole scan) and softi2c (soft bus part) probes
 #define NUM_MPRS 3
-mpr121 mprs[NUM_MPRS];
+#define NUM_HW_MPRS (NUM_MPRS < MPR121_ADDRESSES_PER_BUS ? NUM_MPRS : MPR121_ADDRESSES_PER_BUS)
+#define NUM_SOFT_MPRS (NUM_MPRS - NUM_HW_MPRS)
+mpr121 mprs[NUM_HW_MPRS];
 
+#if NUM_MPRS > SLIDER_BOARDS_MAX_MPRS || NUM_MPRS > MPR_CAL_MAX_CHIPS
+  #error "too many mprs"
+#endif
 
-// loop timing/processing stuff
+// run the I2C bus at 400kHz fast mode instead of 100kHz
+// (the MPR121 supports it, but turn this off if long wires or weak pullups cause read errors)
+#define MPR_I2C_FAST_MODE true
+
+// read the mprs in the background while other tasks run, instead of waiting on each read
+// (keepalive scans still use blocking reads so they can check the chips are running)
+#define SCAN_ASYNC_I2C true
+
+// send slider scans when the MPR121 IRQ line signals a touch change instead of polling
+// (only chips up to the one that released the IRQ are read, and nothing is sent if no touch changed)
+#define SCAN_USE_IRQ true
+
+// with SCAN_USE_IRQ: resend the last scan if nothing changed for X ms
+// (also re-reads every chip, so a missed IRQ can't leave a key stuck)
+// with SCAN_ASYNC_I2C and no IRQs, this is how often a blocking scan checks the chips are running
+#define SCAN_KEEPALIVE_MS 50
+
+// without SCAN_USE_IRQ: send a slider scan every X ms
+#define SCAN_INTERVAL_MS 10
+
+// report analog values (0-255, from MPR121 filtered data vs baseline) for each key instead of just 0 or 0xC0
+// analog values change without the IRQ firing, so this always scans every SCAN_INTERVAL_MS
+//
+// I2C cost per scan (each read is START, address, register, repeated START, address, data..., STOP; ~9 bits per byte):
+//   touch state only: 2 data bytes -> 5 bytes -> 450us/chip at 100kHz, 1.35ms for 3 chips (340us at 400kHz)
+//   analog:          28 data bytes (touch + OOR + filtered data in one burst) -> 31 bytes
+//                    -> 2.8ms/chip at 100kHz (8.4ms for 3, too slow), 0.70ms/chip at 400kHz (2.1ms for 3)
+//   baseline:        12 data bytes -> 15 bytes -> 0.34ms/chip at 400kHz, only every SCAN_ANALOG_BASELINE_INTERVAL scans
+// so analog mode needs MPR_I2C_FAST_MODE
+#define SCAN_ANALOG false
+
+// with SCAN_ANALOG: re-read baselines every X scans (they only drift slowly)
+#define SCAN_ANALOG_BASELINE_INTERVAL 16
+
+// with SCAN_ANALOG: curve used to map (baseline - filtered data) to key values
+// deltas up to the noise floor read as 0, the touch delta reads as 0xC0 (same as a digital touch),
+// and it saturates at 0xFF from the full delta
+#define SCAN_ANALOG_DELTA_NOISE 3
+#define SCAN_ANALOG_DELTA_TOUCH 12
+#define SCAN_ANALOG_DELTA_FULL 24
 
-// sleep for x microseconds after running the main loop
-#define LOOP_SLEEP_US 333
+// IRQ driven scanning is only possible when the reported data can only change with the touch state
+#define SCAN_IRQ_DRIVEN (SCAN_USE_IRQ && !FAKE_DATA && !SCAN_ANALOG)
+
+// fake data doesn't need the read results in time for sending, so it just uses blocking reads
+#define SCAN_ASYNC (SCAN_ASYNC_I2C && !FAKE_DATA)
+
+// allow streaming raw filtered data and baselines for tuning thresholds (SLIDER_SCAN_07 and SLIDER_SCAN_0C, see rawStream.h)
+// while scanning, this reads every electrode's filtered data every RAW_STREAM_INTERVAL_MS on top of the normal scans:
+//   24 data bytes -> 27 bytes -> 0.61ms/chip at 400kHz (1.8ms for 3), in the background with SCAN_ASYNC
+//   and sends it as ~50 bytes per 3 chips, so 3 chips at 200Hz is ~10kB/s next to the scan reports
+#define RAW_STREAM_ENABLED true
+
+// send raw filtered data every X ms while the stream is on
+#define RAW_STREAM_INTERVAL_MS 5
+
+// also send baselines every X raw data packets (they only drift slowly)
+#define RAW_STREAM_BASELINE_INTERVAL 20
+
+#define RAW_STREAM (RAW_STREAM_ENABLED && !FAKE_DATA)
+
+// allow running a synthetic touch load through the report path with SLIDER_LOADGEN, for stress testing (see loadGen.h)
+#define LOADGEN_ENABLED true
+
+#define LOADGEN (LOADGEN_ENABLED && !FAKE_DATA)
+
+// board profiles that can be selected with SLIDER_SET_PROFILE (see sliderdefs.h)
+// the first one is the default, and the selection is saved in EEPROM at EEPROM_PROFILE_ADDR
+#if SLIDER_LEDS
+  #define PROFILE_HW_LEDS NUM_SLIDER_LEDS
+#else
+  #define PROFILE_HW_LEDS 0 // nothing to plan
+#endif
+const sliderProfile sliderProfiles[] PROGMEM = {
+  SLIDER_PROFILE(divaSlider, 12 * NUM_MPRS, PROFILE_HW_LEDS),
+  SLIDER_PROFILE(chuniSlider, 12 * NUM_MPRS, PROFILE_HW_LEDS),
+  #if 12 * NUM_MPRS >= 64
+    SLIDER_PROFILE(chuniSliderTwoRow, 12 * NUM_MPRS, PROFILE_HW_LEDS),
+  #endif
+};
+#define NUM_PROFILES (sizeof(sliderProfiles) / sizeof(sliderProfile))
+
+#define EEPROM_PROFILE_ADDR 0
+
+// mpr filter settings and thresholds from SLIDER_CALIBRATE (see mprCalibration.h), applied whenever scanning starts
+// only kept in EEPROM to save RAM
+#define EEPROM_CALIBRATION_ADDR 1
+
+// last read touch state of every hw input (12 bits per mpr, see sliderdefs.h)
+// kept between scans so IRQ-triggered scans only need to read the chips that changed
+uint16_t sliderTouches[NUM_MPRS];
+
+// replace one mpr's bits of sliderTouches
+// returns whether any of them changed
+bool setMprTouches(byte mprIndex, short touches) {
+  uint16_t newTouches = touches & 0x0FFF;
+  bool changed = (newTouches != sliderTouches[mprIndex]);
+  sliderTouches[mprIndex] = newTouches;
+  return changed;
+}
+
+#if SCAN_ANALOG
+  // analog value (0-255) of each hw input from the last scan
+  byte mprAnalog[12 * NUM_MPRS];
+
+  // baseline of each hw input (upper 8 of 10 bits, as the MPR121 stores it)
+  byte mprBaselines[NUM_MPRS][12];
+  byte scansSinceBaseline = SCAN_ANALOG_BASELINE_INTERVAL; // read baselines on the first scan
+#endif // SCAN_ANALOG
+
+#if SCAN_ASYNC
+  twiAsync mprBus;
+
+  // raw data from the last background read of each mpr
+  #if SCAN_ANALOG
+    #define MPR_SCAN_READ_LEN MPR121_STATUS_AND_DATA_LEN // touch status, OOR status, filtered data
+  #else
+    #define MPR_SCAN_READ_LEN 2 // touch status only
+  #endif
+  byte mprReadBufs[NUM_MPRS][MPR_SCAN_READ_LEN];
+
+  // set while a batch of background reads for a scan is running
+  bool scanReadPending = false;
+
+  // soft bus scan reads that failed, or were skipped because the IRQ line was released (bit i = mpr i, like the hw bus masks)
+  byte softFailedMask = 0;
+  byte softSkippedMask = 0;
+
+  #if !SCAN_IRQ_DRIVEN
+    unsigned long lastMprCheckMillis;
+  #endif
+
+  #if NUM_HW_MPRS * 2 > TWI_ASYNC_MAX_JOBS
+    #error "too many mprs for one batch of background reads"
+  #endif
+#endif // SCAN_ASYNC
+
+#if RAW_STREAM
+  // whether raw data is being streamed, and whether baselines were asked for with SLIDER_SCAN_0C
+  bool rawStreamOn = false;
+  bool rawBaselinesRequested = false;
+
+  byte rawSequence = 0;
+  byte ticksSinceRawBaseline = RAW_STREAM_BASELINE_INTERVAL; // send baselines with the first data
+
+  // filtered data registers and baselines from the last raw read of each mpr
+  byte rawFiltered[NUM_MPRS][24];
+  byte rawBaselines[NUM_MPRS][12];
+  bool rawBaselinesRead; // whether the last raw read included baselines
+
+  #if SCAN_ASYNC
+    // set while a batch of background reads for the raw stream is running (never at the same time as scan reads)
+    bool rawReadPending = false;
+    byte rawSoftFailedMask = 0;
+  #endif
+#endif // RAW_STREAM
+
+#if LOADGEN
+  loadGenerator loadGen;
+
+  // counters for the current (or last) run
+  // (the scheduler's are reset when a run starts, and loop() copies them in while it's going)
+  loadGenReport loadGenStats;
+
+  // main loop scheduler (defined after the task list, at the end)
+  extern taskScheduler scheduler;
+#endif // LOADGEN
+
+
+// loop timing/processing stuff
 
 // time to wait after losing serial connection before disabling scan and LEDs
 #define SERIAL_TIMEOUT_MS 10000
 
 // maximum number of received serial packets to process in one loop
-#define MAX_PACKETS_PER_LOOP 1
+// everything available is normally drained (LED packets are coalesced so only the newest is applied),
+// this just bounds how long a flood of control packets can hold up scanning
+#define MAX_PACKETS_PER_LOOP 16
+
+// maximum rate to push LED data to the strip
+// a new frame is shown straight away if the last one was at least 1/LED_MAX_FPS ago, otherwise as soon as it has been
+// (each update blocks for ~1ms with interrupts off, so LED updates are skipped if they'd delay a scan)
+#define LED_MAX_FPS 120
+#define LED_FRAME_MICROS (1000000UL / LED_MAX_FPS)
+
+// update the status lights every X ms (errors are collected in between)
+#define STATUS_LED_PERIOD_MS 20
+
+
+#if BUTTON_INPUT
+  #define NUM_BUTTONS (sizeof(kbButtons) / sizeof(kbInput))
+  static_assert(NUM_BUTTONS <= BUTTON_CAPTURE_MAX_PINS, "too many buttons");
+
+  // ignore further edges on a button for X us after one is accepted (0 to turn off)
+  // the first edge is sent straight away, this just stops contact bounce from sending extra reports
+  #define BUTTON_DEBOUNCE_US 5000
+
+  // button edges are captured by interrupts with their times, and sent from buttonTask
+  buttonCapture buttonEdges;
+
+  // every button goes in one NKRO report, so chords reach the host together
+  nkroKeyboard buttonKeyboard;
+
+  // buttons in the last report sent (bit n is kbButtons[n])
+  byte lastButtons;
+
+  // time of the last accepted edge of each button
+  unsigned long buttonEdgeMicros[NUM_BUTTONS];
+#endif // BUTTON_INPUT
+
+
+// switch to board profile `index` (must be below NUM_PROFILES)
+// clears anything left over from the old layout, the next LED packet and scan fill it back in
+void selectProfile(byte index) {
+  #if SLIDER_LEDS
+    // an LED packet from before the switch was meant for the old LED plan
+    applyPendingLedPacket();
+  #endif // SLIDER_LEDS
+
+  curProfileIndex = index;
+  curProfile = &sliderProfiles[index];
+
+  memset(sliderBuf, 0, sizeof(sliderBuf));
+  scanPacket.DataLength = pgm_read_byte(&curProfile->keyCount);
+
+  #if SLIDER_LEDS
+    for (byte i = 0; i < NUM_SLIDER_LEDS; i++)
+      sliderLeds[i] = CRGB::Black;
+    setLedUpdate();
+  #endif // SLIDER_LEDS
+}
 
+// select the profile saved in EEPROM (or the default if nothing valid is saved)
+void loadProfile() {
+  byte index = EEPROM.read(EEPROM_PROFILE_ADDR);
+  selectProfile(index < NUM_PROFILES ? index : 0);
+}
 
 void setup() {
   // set pin modes for stuff that's handled in the main sketch file
@@ -127,7 +536,11 @@ void setup() {
   #if BUTTON_INPUT
     for (kbInput &kbi : kbButtons) {
       pinMode(kbi.pin, INPUT_PULLUP);
+      buttonEdges.addPin(kbi.pin);
     }
+    #if !FAKE_DATA || FAKE_DATA_DO_SCANNING
+      buttonEdges.begin();
+    #endif
   #endif // BUTTON_INPUT
 
   // turn on led during setup
@@ -138,16 +551,27 @@ void setup() {
   #if !FAKE_DATA || FAKE_DATA_DO_SCANNING
     for (mpr121 &mpr : mprs) {
       mpr.begin();
-      mpr.ESI = MPR_ESI_1; // get 4ms response time (4 samples * 1ms rate)
+      mpr.ESI = MPR_ESI_1; // get 4ms response time (4 samples * 1ms rate), SLIDER_CALIBRATE may pick something else
       mpr.autoConfigUSL = 256L * (3200 - 700) / 3200; // set autoconfig for 3.2V
     }
+
+    #if NUM_SOFT_MPRS > 0
+      mprSoftBus.begin(PIN_SOFT_SDA, PIN_SOFT_SCL);
+      for (byte i = NUM_HW_MPRS; i < NUM_MPRS; i++)
+        mprWriteRegister(mprAddress(i), MPR121_REG_SOFT_RESET, 0x63);
+    #endif
+
+    #if MPR_I2C_FAST_MODE
+      // after mpr.begin, which may reset the bus
+      Wire.setClock(400000);
+    #endif
   #endif // !FAKE_DATA || FAKE_DATA_DO_SCANNING
 
 
+  loadProfile();
+
   #if SLIDER_LEDS
-    // 5V is LED voltage, not arduino voltage
-    FastLED.setMaxPowerInVoltsAndMilliamps(5, RGB_POWER_LIMIT); 
-    
+    // power limiting is applied by ledTask once per new frame instead of by FastLED on every show
     // originally I used SK6812, but they should be WS2812(B) compatible
     FastLED.addLeds<WS2812B, PIN_SLIDER_LED, GRB>(sliderLeds, NUM_SLIDER_LEDS);
   #endif // SLIDER_LEDS
@@ -160,36 +584,430 @@ void setup() {
 
 
 bool scanOn = false;
+unsigned long lastSliderSendMillis;
 
 // enable or disable slider and button scanning
+#if !FAKE_DATA || FAKE_DATA_DO_SCANNING
+  // start every mpr with all 12 electrodes
+  // QuickMpr121 can't reach the soft bus, so those chips copy the settings of the first chip
+  void startMprs() {
+    for (mpr121 &mpr : mprs) {
+      mpr.start(12);
+    }
+    for (byte i = NUM_HW_MPRS; i < NUM_MPRS; i++)
+      mprCopyConfig(mprAddress(0), mprAddress(i)); // a chip that fails to start is caught by the keepalive check
+  }
+
+  // put every mpr in stop mode
+  void stopMprs() {
+    for (mpr121 &mpr : mprs) {
+      mpr.stop();
+    }
+    for (byte i = NUM_HW_MPRS; i < NUM_MPRS; i++)
+      mprWriteRegister(mprAddress(i), MPR121_REG_ECR, 0);
+  }
+
+  // apply the calibration saved in EEPROM (if there is one) to the started mprs
+  void applySavedCalibration() {
+    mprCalibration cal;
+    EEPROM.get(EEPROM_CALIBRATION_ADDR, cal);
+    if (cal.version != MPR_CALIBRATION_VERSION || cal.numChips != NUM_MPRS)
+      return; // never calibrated, or calibrated for different hardware
+
+    for (byte i = 0; i < NUM_MPRS; i++)
+      mprApplyCalibration(i, cal); // a chip that fails to restart is caught by the keepalive check
+  }
+#endif // !FAKE_DATA || FAKE_DATA_DO_SCANNING
+
 void setScanning(bool on_off) {
+  #if SCAN_ASYNC
+    // Wire can't be used while background reads are running (and results from before a change aren't wanted)
+    mprBus.finish();
+    scanReadPending = false;
+    #if RAW_STREAM
+      rawReadPending = false;
+    #endif
+  #endif
+
   if (on_off && !scanOn) {
     scanOn = true;
+    TRACE(TRACE_SCAN_ON, 0, 0);
     #if !FAKE_DATA || FAKE_DATA_DO_SCANNING
-      for (mpr121 &mpr : mprs) {
-        mpr.start(12);
-      }
+      memset(sliderTouches, 0, sizeof(sliderTouches));
+      startMprs();
+      applySavedCalibration();
       #if BUTTON_INPUT
-        Keyboard.begin();
+        // nothing is pressed on the host yet, so held buttons are sent by the first scan
+        // (edges from while scanning was off don't matter)
+        lastButtons = 0;
+        buttonEdges.flush();
+        for (unsigned long &edgeMicros : buttonEdgeMicros)
+          edgeMicros = micros() - BUTTON_DEBOUNCE_US;
       #endif
     #endif // !FAKE_DATA || FAKE_DATA_DO_SCANNING
   }
   else if (!on_off && scanOn) {
     scanOn = false;
+    TRACE(TRACE_SCAN_OFF, 0, 0);
+    #if RAW_STREAM
+      // the stream has to be asked for again with the next SLIDER_SCAN_07
+      rawStreamOn = false;
+      rawBaselinesRequested = false;
+    #endif
+    #if LOADGEN
+      loadGen.stop();
+    #endif
     #if !FAKE_DATA || FAKE_DATA_DO_SCANNING
-      for (mpr121 &mpr : mprs) {
-        mpr.stop();
-      }
+      stopMprs();
       #if BUTTON_INPUT
-        Keyboard.releaseAll();
-        Keyboard.end();
+        buttonKeyboard.releaseAll();
       #endif
     #endif // !FAKE_DATA || FAKE_DATA_DO_SCANNING
   }
 }
 
-// perform a slider scan and send it to sliderProtocol
-void doSliderScan() {
+#if SCAN_ANALOG
+  // map a filtered data delta from baseline to a key value
+  byte analogCurve(int delta) {
+    if (delta <= SCAN_ANALOG_DELTA_NOISE)
+      return 0;
+    if (delta < SCAN_ANALOG_DELTA_TOUCH)
+      return (long)(delta - SCAN_ANALOG_DELTA_NOISE) * 0xC0 / (SCAN_ANALOG_DELTA_TOUCH - SCAN_ANALOG_DELTA_NOISE);
+    if (delta < SCAN_ANALOG_DELTA_FULL)
+      return 0xC0 + (long)(delta - SCAN_ANALOG_DELTA_TOUCH) * (0xFF - 0xC0) / (SCAN_ANALOG_DELTA_FULL - SCAN_ANALOG_DELTA_TOUCH);
+    return 0xFF;
+  }
+
+  // update sliderTouches and mprAnalog from an mpr's touch status, OOR status and filtered data registers
+  void applyMprAnalog(byte mprIndex, const byte* data) {
+    setMprTouches(mprIndex, data[0] | (data[1] << 8));
+    
+    const byte* filtered = &data[MPR121_REG_FILTERED_DATA];
+    for (byte j = 0; j < 12; j++) {
+      int filteredValue = filtered[2*j] | ((filtered[2*j + 1] & 0x03) << 8);
+      int delta = (mprBaselines[mprIndex][j] << 2) - filteredValue; // touching lowers filtered data
+      mprAnalog[12*mprIndex + j] = analogCurve(delta);
+    }
+  }
+
+  // burst read touch state and filtered data from an mpr, updating sliderTouches and mprAnalog
+  // baselines are refreshed every SCAN_ANALOG_BASELINE_INTERVAL scans of the last chip
+  // returns false if the chip didn't respond
+  bool readMprAnalog(byte mprIndex) {
+    byte address = mprAddress(mprIndex);
+    byte data[MPR121_STATUS_AND_DATA_LEN];
+
+    if (mprIndex == 0 && ++scansSinceBaseline >= SCAN_ANALOG_BASELINE_INTERVAL)
+      scansSinceBaseline = 0;
+    
+    if (scansSinceBaseline == 0) {
+      if (!mprReadRegisters(address, MPR121_REG_BASELINE, mprBaselines[mprIndex], 12))
+        return false;
+    }
+
+    // touch status, OOR status and filtered data for all 12 electrodes (this also clears the IRQ)
+    if (!mprReadRegisters(address, MPR121_REG_TOUCH_STATUS, data, sizeof(data)))
+      return false;
+
+    applyMprAnalog(mprIndex, data);
+    return true;
+  }
+#endif // SCAN_ANALOG
+
+#if !FAKE_DATA || FAKE_DATA_DO_SCANNING
+  // whether mpr i is running (not in stop mode)
+  bool mprRunning(byte i) {
+    #if NUM_SOFT_MPRS > 0
+      if (i >= NUM_HW_MPRS) {
+        byte ecr;
+        return mprReadRegisters(mprAddress(i), MPR121_REG_ECR, &ecr, 1) && ecr != 0;
+      }
+    #endif // NUM_SOFT_MPRS > 0
+    return mprs[i].checkRunning();
+  }
+
+  #if !SCAN_ANALOG
+    // read the touch state of mpr i (bit n = electrode n)
+    // returns false if the chip couldn't be read
+    bool readMprTouches(byte i, short &touches) {
+      #if NUM_SOFT_MPRS > 0
+        if (i >= NUM_HW_MPRS) {
+          byte status[2];
+          if (!mprReadRegisters(mprAddress(i), MPR121_REG_TOUCH_STATUS, status, 2))
+            return false;
+          touches = status[0] | (status[1] << 8);
+          return true;
+        }
+      #endif // NUM_SOFT_MPRS > 0
+
+      #if MPR121_USE_BITFIELDS
+        touches = mprs[i].readTouchState();
+      #else // MPR121_USE_BITFIELDS
+        bool* touchArray = mprs[i].readTouchState();
+        touches = 0;
+        for (byte j = 0; j < 12; j++) {
+          if (touchArray[j])
+            bitSet(touches, j);
+        }
+      #endif // MPR121_USE_BITFIELDS
+      return true;
+    }
+  #endif // !SCAN_ANALOG
+
+  // read mpr touches into sliderTouches
+  // if irqOnly is set, stop as soon as the (shared) IRQ line is released --
+  //   reading a chip's touch state clears its IRQ, so the remaining chips have nothing new
+  //   (this also skips checkRunning to keep the fast path to a single I2C read)
+  // returns whether any touch state changed
+  bool readSliderTouches(bool irqOnly) {
+    bool changed = false;
+    PROBE_START(PROBE_I2C_SCAN);
+    
+    for (byte i = 0; i < NUM_MPRS; i++) {
+      // error condition, should hopefully never be triggered
+      if (!irqOnly && !mprRunning(i)) {
+        curError |= ERRORSTATE_MPR_STOPPED;
+        setScanning(false);
+        return false;
+      }
+      
+      #if SCAN_ANALOG
+        if (!readMprAnalog(i)) {
+          curError |= ERRORSTATE_MPR_STOPPED;
+          setScanning(false);
+          return false;
+        }
+        changed = true; // analog values are always sent
+      #else // SCAN_ANALOG
+        short touches;
+        if (readMprTouches(i, touches))
+          changed |= setMprTouches(i, touches);
+        else
+          curError |= ERRORSTATE_I2C_FAILURE; // keep the last state, the keepalive check catches stopped chips
+      #endif // SCAN_ANALOG
+
+      if (irqOnly && digitalRead(PIN_SLIDER_IRQ) == HIGH)
+        break;
+    }
+
+    PROBE_STOP(PROBE_I2C_SCAN);
+    return changed;
+  }
+#endif // !FAKE_DATA || FAKE_DATA_DO_SCANNING
+
+#if SCAN_ASYNC
+  // step background reads (called by the scheduler before every task, and by the soft bus while it's clocking)
+  void pollMprBus() {
+    mprBus.poll();
+  }
+
+  #if SCAN_IRQ_DRIVEN
+    // whether the (shared) IRQ line has been released, so the chips not read yet have nothing new
+    bool mprIrqReleased() {
+      return digitalRead(PIN_SLIDER_IRQ) == HIGH;
+    }
+  #endif // SCAN_IRQ_DRIVEN
+
+  // queue background reads of the hw bus mprs for a scan, and read the soft bus mprs
+  // if irqOnly is set, stop reading on each bus once the IRQ line is released, like readSliderTouches --
+  //   the chips share one IRQ line, so which ones asserted it is only known by reading them in turn.
+  //   the hw bus checks it as each read finishes and skips the rest, the soft bus before each chip
+  void startSliderRead(bool irqOnly) {
+    PROBE_START(PROBE_I2C_SCAN);
+
+    for (byte i = 0; i < NUM_HW_MPRS; i++)
+      mprBus.queueRead(mprAddress(i), MPR121_REG_TOUCH_STATUS, mprReadBufs[i], MPR_SCAN_READ_LEN);
+    #if SCAN_IRQ_DRIVEN
+      if (irqOnly)
+        mprBus.setStopCheck(NUM_HW_MPRS, mprIrqReleased);
+    #endif
+
+    #if SCAN_ANALOG
+      // baselines go after the scan data so they don't hold it up (they're used from the next scan)
+      if (++scansSinceBaseline >= SCAN_ANALOG_BASELINE_INTERVAL) {
+        scansSinceBaseline = 0;
+        for (byte i = 0; i < NUM_HW_MPRS; i++)
+          mprBus.queueRead(mprAddress(i), MPR121_REG_BASELINE, mprBaselines[i], 12);
+      }
+    #endif // SCAN_ANALOG
+
+    #if NUM_SOFT_MPRS > 0
+      // the soft bus is clocked by the CPU, so its chips are read now, stepping the hw bus reads on every clock edge
+      PROBE_START(PROBE_SOFT_I2C);
+      mprSoftBus.setIdleHook(pollMprBus);
+      softFailedMask = 0;
+      softSkippedMask = 0;
+      for (byte i = NUM_HW_MPRS; i < NUM_MPRS; i++) {
+        #if SCAN_IRQ_DRIVEN
+          if (irqOnly && mprIrqReleased()) {
+            bitSet(softSkippedMask, i);
+            continue;
+          }
+        #endif
+        if (!mprReadRegisters(mprAddress(i), MPR121_REG_TOUCH_STATUS, mprReadBufs[i], MPR_SCAN_READ_LEN))
+          bitSet(softFailedMask, i);
+        #if SCAN_ANALOG
+          if (scansSinceBaseline == 0 && !mprReadRegisters(mprAddress(i), MPR121_REG_BASELINE, mprBaselines[i], 12))
+            bitSet(softFailedMask, i);
+        #endif
+      }
+      mprSoftBus.setIdleHook(NULL);
+      PROBE_STOP(PROBE_SOFT_I2C);
+    #endif // NUM_SOFT_MPRS > 0
+
+    scanReadPending = true;
+  }
+
+  // apply finished background reads to sliderTouches (and mprAnalog)
+  // chips that couldn't be read, or were skipped after the IRQ was released, keep their last state
+  // returns whether any touch state changed
+  bool finishSliderRead() {
+    PROBE_STOP(PROBE_I2C_SCAN);
+    scanReadPending = false;
+
+    byte failedMask = mprBus.getFailedMask(); // scan reads are queued first, so bit i is mpr i
+    if (failedMask || softFailedMask)
+      curError |= ERRORSTATE_I2C_FAILURE;
+
+    // hw bus bits past its chips are baseline reads, and the soft bus chips have their own masks
+    failedMask = (failedMask & ((1 << NUM_HW_MPRS) - 1)) | softFailedMask;
+    byte skippedMask = (mprBus.getSkippedMask() & ((1 << NUM_HW_MPRS) - 1)) | softSkippedMask;
+    
+    bool changed = false;
+    for (byte i = 0; i < NUM_MPRS; i++) {
+      if (bitRead(failedMask | skippedMask, i))
+        continue;
+
+      #if SCAN_ANALOG
+        applyMprAnalog(i, mprReadBufs[i]);
+        changed = true; // analog values are always sent
+      #else // SCAN_ANALOG
+        changed |= setMprTouches(i, mprReadBufs[i][0] | (mprReadBufs[i][1] << 8));
+      #endif // SCAN_ANALOG
+    }
+
+    return changed;
+  }
+#endif // SCAN_ASYNC
+
+#if RAW_STREAM
+  // send the last raw read as SLIDER_REPORT_06 packets (and SLIDER_REPORT_0B if baselines were read)
+  // chips are split RAW_CHIPS_PER_PACKET to a packet
+  void sendRawPackets() {
+    byte data[max(SLIDER_REPORT_06_MAX_DATA, SLIDER_REPORT_0B_MAX_DATA)];
+    sliderPacket pkt = { SLIDER_REPORT_06, data, 0, true };
+
+    for (byte first = 0; first < NUM_MPRS; first += RAW_CHIPS_PER_PACKET) {
+      byte chips = min(NUM_MPRS - first, RAW_CHIPS_PER_PACKET);
+      data[0] = rawSequence;
+      data[1] = first;
+      data[2] = chips;
+
+      pkt.Command = SLIDER_REPORT_06;
+      rawPackFiltered(rawFiltered[first], 12 * chips, &data[RAW_HEADER_LEN]);
+      pkt.DataLength = RAW_HEADER_LEN + RAW_PACKED_LEN(12 * chips);
+      sendSliderPacket(pkt);
+
+      if (rawBaselinesRead) {
+        pkt.Command = SLIDER_REPORT_0B;
+        memcpy(&data[RAW_HEADER_LEN], rawBaselines[first], 12 * chips);
+        pkt.DataLength = RAW_HEADER_LEN + 12 * chips;
+        sendSliderPacket(pkt);
+      }
+    }
+
+    rawSequence++;
+  }
+
+  // handle SLIDER_SCAN_07: data is [on] to start or stop the raw data stream (no data starts it)
+  // the response data is [on]. data only flows while scanning is on, and stopping scanning stops the stream
+  void setRawStream(const sliderPacket &request) {
+    rawStreamOn = (request.DataLength == 0) || request.Data[0];
+
+    byte response[1] = { rawStreamOn };
+    sliderPacket responsePacket = { SLIDER_SCAN_07, response, sizeof(response), true };
+    sendSliderPacket(responsePacket);
+  }
+
+  // whether baselines should be read with this raw read (counts raw reads)
+  bool rawBaselinesDue() {
+    if (rawBaselinesRequested || ++ticksSinceRawBaseline >= RAW_STREAM_BASELINE_INTERVAL) {
+      rawBaselinesRequested = false;
+      ticksSinceRawBaseline = 0;
+      return true;
+    }
+    return false;
+  }
+
+  // check whether raw data should be read
+  bool rawStreamReady() {
+    if (!scanOn || !(rawStreamOn || rawBaselinesRequested))
+      return false;
+
+    #if SCAN_ASYNC
+      if (scanReadPending || rawReadPending)
+        return false; // the scan (or the last raw read) has the bus
+    #endif
+    return true;
+  }
+
+  // read raw data from every mpr, and send it (or start background reads that rawReadDoneTask sends)
+  // a one-off SLIDER_SCAN_0C request without the stream sends baselines with whatever filtered data is read alongside
+  void rawStreamTask() {
+    rawBaselinesRead = rawBaselinesDue();
+
+    #if SCAN_ASYNC
+      for (byte i = 0; i < NUM_HW_MPRS; i++)
+        mprBus.queueRead(mprAddress(i), MPR121_REG_FILTERED_DATA, rawFiltered[i], 24);
+      if (rawBaselinesRead) {
+        for (byte i = 0; i < NUM_HW_MPRS; i++)
+          mprBus.queueRead(mprAddress(i), MPR121_REG_BASELINE, rawBaselines[i], 12);
+      }
+
+      #if NUM_SOFT_MPRS > 0
+        mprSoftBus.setIdleHook(pollMprBus);
+        rawSoftFailedMask = 0;
+        for (byte i = NUM_HW_MPRS; i < NUM_MPRS; i++) {
+          if (!mprReadRegisters(mprAddress(i), MPR121_REG_FILTERED_DATA, rawFiltered[i], 24) ||
+              (rawBaselinesRead && !mprReadRegisters(mprAddress(i), MPR121_REG_BASELINE, rawBaselines[i], 12)))
+            bitSet(rawSoftFailedMask, i);
+        }
+        mprSoftBus.setIdleHook(NULL);
+      #endif // NUM_SOFT_MPRS > 0
+
+      rawReadPending = true;
+    #else // SCAN_ASYNC
+      for (byte i = 0; i < NUM_MPRS; i++) {
+        if (!mprReadRegisters(mprAddress(i), MPR121_REG_FILTERED_DATA, rawFiltered[i], 24) ||
+            (rawBaselinesRead && !mprReadRegisters(mprAddress(i), MPR121_REG_BASELINE, rawBaselines[i], 12))) {
+          curError |= ERRORSTATE_I2C_FAILURE; // skip this one, a stopped chip is caught by the scan keepalive
+          return;
+        }
+      }
+      sendRawPackets();
+    #endif // SCAN_ASYNC
+  }
+
+  #if SCAN_ASYNC
+    // check whether background reads for the raw stream have finished
+    bool rawReadDoneReady() {
+      return rawReadPending && mprBus.idle();
+    }
+
+    // send raw data from finished background reads (nothing is sent if any read failed)
+    void rawReadDoneTask() {
+      rawReadPending = false;
+      if (mprBus.getFailedMask() || rawSoftFailedMask) {
+        curError |= ERRORSTATE_I2C_FAILURE;
+        return;
+      }
+      sendRawPackets();
+    }
+  #endif // SCAN_ASYNC
+#endif // RAW_STREAM
+
+// fill sliderBuf from the last read touch state (or fake data) and send it to sliderProtocol
+void sendSliderScan() {
   // clear the output buffer
   memset(sliderBuf, 0, sizeof(sliderBuf));
   
@@ -216,89 +1034,293 @@ void doSliderScan() {
         lastResetMillis = millis();
       }
     #endif
+  #else // FAKE_DATA
+    // apply touch data to output buffer (keys past keyCount stay cleared)
+    // (a running load generator's touches replace what was read)
+    #if SCAN_ANALOG
+      const byte* analog = mprAnalog;
+      #if LOADGEN
+        byte loadAnalog[12 * NUM_MPRS];
+        if (loadGen.isRunning()) {
+          loadGen.fillAnalog(loadAnalog, NUM_MPRS);
+          analog = loadAnalog;
+        }
+      #endif // LOADGEN
+      auto remapAnalog = (void (*)(const byte*, byte*))pgm_read_ptr(&curProfile->remapAnalog);
+      remapAnalog(analog, sliderBuf);
+    #else
+      const uint16_t* touches = sliderTouches;
+      #if LOADGEN
+        uint16_t loadTouches[NUM_MPRS];
+        if (loadGen.isRunning()) {
+          loadGen.fillTouches(loadTouches, NUM_MPRS);
+          touches = loadTouches;
+        }
+      #endif // LOADGEN
+      auto remapTouches = (void (*)(const uint16_t*, byte*))pgm_read_ptr(&curProfile->remapTouches);
+      remapTouches(touches, sliderBuf);
+    #endif
   #endif // FAKE_DATA
   
-  #if !FAKE_DATA || FAKE_DATA_DO_SCANNING
-    static const byte numInputTouches = 12 * NUM_MPRS;
-    static bool allTouches[numInputTouches];
+  lastSliderSendMillis = millis();
   
-    // read all mpr touches into allTouches
-    for (byte i = 0; i < NUM_MPRS; i++) {
-      mpr121 &mpr = mprs[i];
-
-      // error condition, should hopefully never be triggered
-      if (!mpr.checkRunning()) {
-        curError |= ERRORSTATE_MPR_STOPPED;
-        setScanning(false);
-        return;
-      }
-      
-      #if MPR121_USE_BITFIELDS
-        short touches = mpr.readTouchState();
-        for (byte j = 0; j < 12; j++) {
-          allTouches[12*i + j] = bitRead(touches, j);
-        }
-      #else // MPR121_USE_BITFIELDS
-        bool* touches = mpr.readTouchState();
-        memcpy(&allTouches[12*i], touches, sizeof(bool[12]));
-      #endif // MPR121_USE_BITFIELDS
+  PROBE_START(PROBE_SEND);
+  bool sent = sendSliderPacket(scanPacket);
+  PROBE_STOP(PROBE_SEND);
+  PROBE_STOP(PROBE_REPORT);
+
+  #if LOADGEN
+    if (loadGen.isRunning()) {
+      if (sent)
+        loadGenStats.reports++;
+      else
+        loadGenStats.sendFailures++;
     }
+  #else
+    (void)sent;
+  #endif // LOADGEN
+}
 
-    #if !FAKE_DATA
-      // apply touch data to output buffer
-      for (byte i = 0; i < divaSlider.keyCount && i < sizeof(sliderBuf); i++) { // for all keys, with bounds limited
-        byte inputPos = divaSlider.keyMap[i];
-  
-        if (inputPos < numInputTouches && allTouches[inputPos]) { // check the result to read is in-range
-          sliderBuf[i] |=  0xC0; // note this uses bitwise or to stack nicely
-        }
-      }
-    #endif // !FAKE_DATA
+// perform a full slider scan and send it to sliderProtocol
+void doSliderScan() {
+  #if !FAKE_DATA || FAKE_DATA_DO_SCANNING
+    readSliderTouches(false);
+    if (!scanOn) // reading failed and scanning was stopped
+      return;
   #endif // !FAKE_DATA || FAKE_DATA_DO_SCANNING
-  
-  if (!sliderProtocol.sendPacket(scanPacket))
-    curError |= ERRORSTATE_SERIAL_SEND_FAILURE;
+
+  sendSliderScan();
 }
 
 #if BUTTON_INPUT
-  // perform a button scan and send it to Keyboard
+  // debounced button state after seeing `buttons` at `timeMicros`
+  // (changes on buttons that had an edge accepted in the last BUTTON_DEBOUNCE_US are ignored)
+  byte debounceButtons(byte buttons, unsigned long timeMicros) {
+    byte result = lastButtons;
+    byte changed = buttons ^ lastButtons;
+    for (byte i = 0; i < NUM_BUTTONS; i++) {
+      if ((changed & (1 << i)) && timeMicros - buttonEdgeMicros[i] >= BUTTON_DEBOUNCE_US)
+        result ^= 1 << i;
+    }
+    return result;
+  }
+
+  // send one keyboard report with `buttons` pressed, with their edges at `timeMicros`
+  // returns false if USB wasn't ready (nothing is changed, so it can be tried again)
+  bool sendButtons(byte buttons, unsigned long timeMicros) {
+    buttonKeyboard.clear();
+    for (byte i = 0; i < NUM_BUTTONS; i++) {
+      if (buttons & (1 << i))
+        buttonKeyboard.press(kbButtons[i].usage);
+    }
+    if (!buttonKeyboard.send())
+      return false;
+
+    byte changed = buttons ^ lastButtons;
+    for (byte i = 0; i < NUM_BUTTONS; i++) {
+      if (changed & (1 << i))
+        buttonEdgeMicros[i] = timeMicros;
+    }
+    lastButtons = buttons;
+    return true;
+  }
+
+  // send reports for captured button edges, in order
   void doButtonScan() {
     #if !FAKE_DATA || FAKE_DATA_DO_SCANNING
-      for (kbInput &kbi : kbButtons) {
-        bool state = digitalRead(kbi.pin);
-        #if !FAKE_DATA
-          if (state != kbi.lastState) {
-            if (state == LOW) // LOW is pressed
-              Keyboard.press(kbi.key);
-            else
-              Keyboard.release(kbi.key);
+      #if !BUTTON_CAPTURE_INTERRUPTS
+        buttonEdges.sample(); // nothing samples in the background
+      #endif
 
-            kbi.lastState = state;
+      buttonEvent event;
+      while (buttonEdges.peek(event)) {
+        #if !FAKE_DATA
+          byte buttons = debounceButtons(event.buttons, event.micros);
+          if (buttons != lastButtons) {
+            if (!sendButtons(buttons, event.micros))
+              return; // try this event again next time
+            PROBE_RECORD(PROBE_BUTTON, micros() - event.micros);
           }
-        #endif // !FAKE_DATE
+        #endif // !FAKE_DATA
+        buttonEdges.pop();
       }
+
+      #if !FAKE_DATA
+        // a change ignored as bounce (or dropped from a full queue) is picked up from the pins
+        // once its button's debounce time is over
+        byte buttons = buttonEdges.read();
+        if (buttons != lastButtons) {
+          unsigned long now = micros();
+          buttons = debounceButtons(buttons, now);
+          if (buttons != lastButtons)
+            sendButtons(buttons, now);
+        }
+      #endif // !FAKE_DATA
     #endif // !FAKE_DATA || FAKE_DATA_DO_SCANNING
   }
 #endif
 
 
 // timing vars used in main loop
-int sleepTime = LOOP_SLEEP_US;
-unsigned long lastSliderSendMillis;
 unsigned long lastSerialRecvMillis = -SERIAL_TIMEOUT_MS;
 unsigned long loopCount = 0;
 
+// received packet statistics, read with SLIDER_STATS
+// (framesDropped is only filled in from sliderProtocol.getDroppedFrames() when they're sent)
+sliderRxStats rxStats;
+
+// respond to SLIDER_STATS with rxStats (request data is ignored)
+void sendRxStats() {
+  rxStats.framesDropped = sliderProtocol.getDroppedFrames();
+  sliderPacket responsePacket = { SLIDER_STATS, (byte*)&rxStats, sizeof(rxStats), true };
+  sendSliderPacket(responsePacket);
+}
+
+#if PROFILER_ENABLED
+  // respond to SLIDER_PROFILE with one probe's histogram
+  // request data is [probe index], or [probe index, 1] to also reset the probe (no data reads probe 0)
+  // an out of range probe gets an empty response
+  void sendProfileReport(const sliderPacket &request) {
+    byte probe = (request.DataLength > 0) ? request.Data[0] : 0;
+    bool reset = (request.DataLength > 1) && request.Data[1];
+
+    profileReport report;
+    sliderPacket reportPacket = { SLIDER_PROFILE, (byte*)&report, sizeof(report), true };
+
+    if (probe < NUM_PROBES) {
+      report.probe = probe;
+      report.probeCount = NUM_PROBES;
+      memcpy_P(report.name, probeNames[probe], PROFILER_NAME_LEN);
+      probes[probe].fillReport(report);
+      if (reset)
+        probes[probe].reset();
+    }
+    else {
+      reportPacket.DataLength = 0;
+    }
+
+    sendSliderPacket(reportPacket);
+  }
+#endif // PROFILER_ENABLED
+
+// handle SLIDER_SET_PROFILE: data is [index] to select and save a profile, or empty to just query
+// the response data is [selected index, profile count]
+void setProfile(const sliderPacket &request) {
+  if (request.DataLength > 0 && request.Data[0] < NUM_PROFILES && request.Data[0] != curProfileIndex) {
+    selectProfile(request.Data[0]);
+    EEPROM.update(EEPROM_PROFILE_ADDR, curProfileIndex);
+  }
+
+  byte response[2] = { curProfileIndex, NUM_PROFILES };
+  sliderPacket responsePacket = { SLIDER_SET_PROFILE, response, sizeof(response), true };
+  sendSliderPacket(responsePacket);
+}
+
+#if TRACE_ENABLED
+  // respond to SLIDER_TRACE with a page of the trace, oldest record first
+  // request data is [first record] (no data reads from 0)
+  // the response data is [record count, first record, TRACE_TICK_LOG2, up to TRACE_PAGE_RECORDS traceRecords]
+  // reading from 0 stops recording until the last page has been read (or another command arrives),
+  // so the pages all come from the same snapshot
+  #define TRACE_PAGE_RECORDS 7
+  static_assert(3 + TRACE_PAGE_RECORDS * sizeof(traceRecord) <= SLIDER_SERIAL_SEND_MAX_DATA, "trace page too long");
+  void sendTraceDump(const sliderPacket &request) {
+    byte offset = (request.DataLength > 0) ? request.Data[0] : 0;
+    if (offset == 0)
+      protocolTrace.freeze(true);
+
+    byte response[3 + TRACE_PAGE_RECORDS * sizeof(traceRecord)];
+    byte count = protocolTrace.getCount();
+    byte copied = protocolTrace.copyRecords(offset, (traceRecord*)&response[3], TRACE_PAGE_RECORDS);
+    response[0] = count;
+    response[1] = offset;
+    response[2] = TRACE_TICK_LOG2;
+
+    if (offset + copied >= count)
+      protocolTrace.freeze(false);
+
+    sliderPacket responsePacket = { SLIDER_TRACE, response, (byte)(3 + copied * sizeof(traceRecord)), true };
+    sendSliderPacket(responsePacket);
+  }
+#endif // TRACE_ENABLED
+
+#if LOADGEN
+  // handle SLIDER_LOADGEN: data is a loadGenSettings to start a run (replacing the last one), or empty to just query
+  // a pattern of LOADGEN_OFF stops the run, and runs can only be started while scanning is on (stopping scanning stops them)
+  // the response data is a loadGenReport for the current (or last) run
+  void setLoadGen(const sliderPacket &request) {
+    if (request.DataLength >= sizeof(loadGenSettings)) {
+      loadGen.stop();
+
+      loadGenSettings settings;
+      memcpy(&settings, request.Data, sizeof(settings));
+      if (scanOn && settings.pattern != LOADGEN_OFF && settings.pattern < NUM_LOADGEN_PATTERNS) {
+        memset(&loadGenStats, 0, sizeof(loadGenStats));
+        scheduler.resetStats();
+        loadGen.start(settings);
+      }
+    }
+
+    loadGenStats.running = loadGen.isRunning();
+    loadGenStats.settings = loadGen.getSettings();
+    loadGenStats.elapsedMillis = loadGen.getElapsedMillis();
+    loadGenStats.steps = loadGen.getStep();
+
+    sliderPacket responsePacket = { SLIDER_LOADGEN, (byte*)&loadGenStats, sizeof(loadGenStats), true };
+    sendSliderPacket(responsePacket);
+  }
+#endif // LOADGEN
+
+#if !FAKE_DATA || FAKE_DATA_DO_SCANNING
+  // handle SLIDER_CALIBRATE: find the fastest mpr settings that are stable on this slider, and save them
+  // blocks for up to ~8 seconds, and the slider mustn't be touched while it runs
+  // the response data is [mprCalResult, setting index, response time ms, max idle noise]
+  void calibrateMprs() {
+    bool wasScanning = scanOn;
+    setScanning(false);
+
+    // measuring needs the chips running (and started the same way as for scanning)
+    startMprs();
+
+    mprCalibration cal;
+    memset(&cal, 0, sizeof(cal));
+    mprCalResult result = mprCalibrate(NUM_MPRS, cal);
+    if (result != MPR_CAL_I2C_ERROR)
+      EEPROM.put(EEPROM_CALIBRATION_ADDR, cal);
+
+    stopMprs();
+    if (wasScanning)
+      setScanning(true);
+
+    byte response[4] = { result, cal.settingIndex, mprSettingResponseMs(cal.setting), cal.maxNoise };
+    sliderPacket responsePacket = { SLIDER_CALIBRATE, response, sizeof(response), true };
+    sendSliderPacket(responsePacket);
+  }
+#endif // !FAKE_DATA || FAKE_DATA_DO_SCANNING
+
 #if SLIDER_LEDS
-  bool ledUpdate = false;
+  // keep a SLIDER_LED packet for applying later, replacing any older one
+  void queueLedPacket(const sliderPacket &pkt) {
+    if (pkt.DataLength == 0)
+      return;
+    
+    if (pendingLedLength > 0)
+      rxStats.ledPacketsCoalesced++;
+
+    // anything past the last LED would be ignored anyway
+    pendingLedLength = min(pkt.DataLength, (byte)LED_PACKET_MAX_LENGTH);
+    memcpy(pendingLedData, pkt.Data, pendingLedLength);
+  }
 #endif // SLIDER_LEDS
 
-void loop() {
-  // clear errors (they'll be reset if necessary)
-  curError = ERRORSTATE_NONE;
+// receive and handle slider packets, and check for serial timeouts
+void serialTask() {
+  PROBE_START(PROBE_SERIAL);
 
   // check for new slider data
   byte pktCount = 0;
   while (pktCount < MAX_PACKETS_PER_LOOP) {
+    PROBE_START(PROBE_PARSE);
     sliderPacket pkt = sliderProtocol.getPacket();
 
     // if there was no data or the buffer was incomplete, `Command` will equal `(sliderCommand)0`
@@ -306,6 +1328,14 @@ void loop() {
     if (pkt.Command == (sliderCommand)0) {
       break;
     }
+    PROBE_STOP(PROBE_PARSE);
+    TRACE(pkt.IsValid ? (TRACE_RX | TRACE_FLAG_OK) : TRACE_RX, pkt.Command, pkt.DataLength);
+
+    #if TRACE_ENABLED
+      // a dump that's interrupted by anything else shouldn't leave recording stopped
+      if (pkt.Command != SLIDER_TRACE)
+        protocolTrace.freeze(false);
+    #endif // TRACE_ENABLED
 
     // increment these when there's any packets, valid or not
     lastSerialRecvMillis = millis();
@@ -317,21 +1347,22 @@ void loop() {
     }
     else {
       curError |= ERRORSTATE_PACKET_CHECKSUM;
+      rxStats.packetsInvalid++;
       continue;
     }
 
     switch(pkt.Command) {
       case SLIDER_BOARDINFO:
-        memcpy(boardInfoData.model, divaSlider.model, sizeof(boardInfo::model));
-        memcpy(boardInfoData.chipNumber, divaSlider.chipNumber, sizeof(boardInfo::chipNumber));
-        if (!sliderProtocol.sendPacket(boardinfoPacket))
-          curError |= ERRORSTATE_SERIAL_SEND_FAILURE;
+        memcpy_P(boardInfoData.model, curProfile->model, sizeof(boardInfo::model));
+        memcpy_P(boardInfoData.chipNumber, curProfile->chipNumber, sizeof(boardInfo::chipNumber));
+        sendSliderPacket(boardinfoPacket);
         break;
 
       case SLIDER_SCAN_REPORT:
         // there's no way this will give accurate results,
         // but at least it's implemented on a protocol level now
         if (!scanOn) {
+          PROBE_START(PROBE_REPORT);
           setScanning(true);
           delay(10);
           doSliderScan();
@@ -340,64 +1371,86 @@ void loop() {
         break; // doSliderScan() sends the response
         
       case SLIDER_SCAN_ON:
-        sliderProtocol.sendPacket(scanPacket);
+        sendSliderPacket(scanPacket);
         setScanning(true);
         break; // no response needed
         
       case SLIDER_SCAN_OFF:
         setScanning(false);
         emptyPacket.Command = SLIDER_SCAN_OFF;
-        if (!sliderProtocol.sendPacket(emptyPacket))
-          curError |= ERRORSTATE_SERIAL_SEND_FAILURE;
+        sendSliderPacket(emptyPacket);
         break;
         
       case SLIDER_LED:
+        rxStats.ledPackets++;
         #if SLIDER_LEDS
-          if (pkt.DataLength > 0) {
-            FastLED.setBrightness((pkt.Data[0] & 0x3f) * RGB_BRIGHTNESS / 0x3f); // this seems to max out at 0x3f (63), use that for division
-  
-            byte maxPacketLeds = (pkt.DataLength - 1) / 3; // subtract 1 because of brightness byte
-            
-            for (byte i = 0; i < divaSlider.ledCount; i++) {
-              byte outputLed = divaSlider.ledMap[i];
-  
-              if (outputLed < NUM_SLIDER_LEDS) { // make sure there's no out of bounds writes
-                if (i < maxPacketLeds) {
-                  if (outputLed % 2 == 0) {
-                    sliderLeds[outputLed].b = pkt.Data[i*3 + 1]; // start with + 1 because of brightness byte
-                    sliderLeds[outputLed].r = pkt.Data[i*3 + 2];
-                    sliderLeds[outputLed].g = pkt.Data[i*3 + 3];
-                  }
-                  else {
-                    // dim values for separators
-                    sliderLeds[outputLed].b = pkt.Data[i*3 + 1] / 2; // start with + 1 because of brightness byte
-                    sliderLeds[outputLed].r = pkt.Data[i*3 + 2] / 2;
-                    sliderLeds[outputLed].g = pkt.Data[i*3 + 3] / 2;
-                  }
-                }
-                else {
-                  sliderLeds[outputLed] = CRGB::Black;
-                }
-              }
-            }
-            ledUpdate = true;
-          }
+          queueLedPacket(pkt);
         #endif // SLIDER_LEDS
         break; // no response needed
+
+      #if PROFILER_ENABLED
+        case SLIDER_PROFILE:
+          sendProfileReport(pkt);
+          break;
+      #endif // PROFILER_ENABLED
+
+      case SLIDER_SET_PROFILE:
+        setProfile(pkt);
+        break;
+
+      case SLIDER_STATS:
+        sendRxStats();
+        break;
+
+      #if TRACE_ENABLED
+        case SLIDER_TRACE:
+          sendTraceDump(pkt);
+          break;
+      #endif // TRACE_ENABLED
+
+      #if !FAKE_DATA || FAKE_DATA_DO_SCANNING
+        case SLIDER_CALIBRATE:
+          calibrateMprs();
+          break;
+      #endif // !FAKE_DATA || FAKE_DATA_DO_SCANNING
+
+      #if RAW_STREAM
+        case SLIDER_SCAN_07:
+          setRawStream(pkt);
+          break;
+
+        case SLIDER_SCAN_0C:
+          // send baselines with the next raw data (as soon as possible while scanning is on)
+          rawBaselinesRequested = true;
+          emptyPacket.Command = SLIDER_SCAN_0C;
+          sendSliderPacket(emptyPacket);
+          break;
+      #endif // RAW_STREAM
+
+      #if LOADGEN
+        case SLIDER_LOADGEN:
+          setLoadGen(pkt);
+          break;
+      #endif // LOADGEN
         
       default:
         emptyPacket.Command = pkt.Command; // just blindly acknowledge unknown commands
-        if (!sliderProtocol.sendPacket(emptyPacket))
-          curError |= ERRORSTATE_SERIAL_SEND_FAILURE;
+        sendSliderPacket(emptyPacket);
         break;
     }
   }
   if (pktCount == MAX_PACKETS_PER_LOOP)
     curError |= ERRORSTATE_PACKET_MAX_REACHED;
 
+  #if SLIDER_LEDS
+    // only the newest LED packet matters
+    applyPendingLedPacket();
+  #endif // SLIDER_LEDS
+
   // disable scan and set error if serial is dead
   if ((millis() - lastSerialRecvMillis) > SERIAL_TIMEOUT_MS) {
     if (scanOn) {
+      TRACE(TRACE_SERIAL_TIMEOUT, 0, 0);
       setScanning(false);
     }
     curError |= ERRORSTATE_SERIAL_TIMEOUT;
@@ -407,50 +1460,184 @@ void loop() {
       // set mode colour for 5s (this should trigger at boot)
       // also use this to black out slider
       if ((millis() - lastSerialRecvMillis) < SERIAL_TIMEOUT_MS + 5000) {
-        FastLED.setBrightness(RGB_BRIGHTNESS);
+        if (ledBrightness != RGB_BRIGHTNESS) {
+          ledBrightness = RGB_BRIGHTNESS;
+          setLedUpdate();
+        }
   
         for (byte i = 0; i < NUM_SLIDER_LEDS; i++) {
-          sliderLeds[i] = CRGB::Black;
+          CRGB colour = (i == MODE_LED_RGB_INDEX) ? CRGB::Teal : CRGB::Black;
+          if (sliderLeds[i] != colour) {
+            sliderLeds[i] = colour;
+            setLedUpdate();
+          }
         }
-        
-        sliderLeds[MODE_LED_RGB_INDEX] = CRGB::Teal;
-  
-        ledUpdate = true;
       }
       else {
         if (sliderLeds[MODE_LED_RGB_INDEX] != (CRGB)CRGB::Black) {
           sliderLeds[MODE_LED_RGB_INDEX] = CRGB::Black;
-          ledUpdate = true;
+          setLedUpdate();
         }
       }
     #endif // SLIDER_LEDS
   }
 
-  #if SLIDER_LEDS
-    // now update LEDs once per loop
-    // done before scanning to reduce delay from receiving to showing
-    if (ledUpdate) {
-      FastLED.show();
-      ledUpdate = false;
-    }
-  #endif // SLIDER_LEDS
+  PROBE_STOP(PROBE_SERIAL);
+}
 
-  // if slider scanning is on, update inputs (as appropriate)
-  if (scanOn) {
-    
-    // if slider touch state has changed (interrupt was triggered), send data (currently disabled)
-    // also send data anyway if slider touch state hasn't changed recently
-    if ( /*(digitalRead(PIN_SLIDER_IRQ) == LOW) ||*/ ((millis() - lastSliderSendMillis) > 10) ) {
-      lastSliderSendMillis = millis();
+// if slider scanning is on, check whether a scan should be sent
+bool sliderScanReady() {
+  if (!scanOn)
+    return false;
+
+  #if SCAN_ASYNC
+    if (scanReadPending)
+      return false; // wait for the last one to finish
+    #if RAW_STREAM
+      if (rawReadPending)
+        return false; // the raw stream has the bus
+    #endif
+  #endif
+
+  #if SCAN_IRQ_DRIVEN
+    // if slider touch state has changed (interrupt was triggered), or
+    // if slider touch state hasn't changed recently (so data should be sent anyway)
+    return (digitalRead(PIN_SLIDER_IRQ) == LOW) || ((millis() - lastSliderSendMillis) > SCAN_KEEPALIVE_MS);
+  #else // SCAN_IRQ_DRIVEN
+    return true; // sliderScanTask is periodic
+  #endif // SCAN_IRQ_DRIVEN
+}
+
+// send a slider scan (only runs when sliderScanReady)
+void sliderScanTask() {
+  PROBE_START(PROBE_REPORT);
+
+  #if SCAN_IRQ_DRIVEN
+    // read only what's needed for IRQs, send a full scan for keepalives
+    if (digitalRead(PIN_SLIDER_IRQ) == LOW) {
+      #if SCAN_ASYNC
+        startSliderRead(true); // sent by sliderReadDoneTask
+      #else
+        if (readSliderTouches(true))
+          sendSliderScan();
+      #endif
+    }
+    else {
+      doSliderScan();
+    }
+  #elif SCAN_ASYNC
+    // background reads, with a blocking scan every so often to check the chips are running
+    if ((millis() - lastMprCheckMillis) > SCAN_KEEPALIVE_MS) {
+      lastMprCheckMillis = millis();
       doSliderScan();
     }
+    else {
+      startSliderRead(false); // sent by sliderReadDoneTask
+    }
+  #else // SCAN_IRQ_DRIVEN
+    doSliderScan();
+  #endif // SCAN_IRQ_DRIVEN
+}
 
-    #if BUTTON_INPUT
-      doButtonScan();
+#if SCAN_ASYNC
+  // check whether background reads for a scan have finished
+  bool sliderReadDoneReady() {
+    return scanReadPending && mprBus.idle();
+  }
+
+  // send a slider scan from finished background reads
+  void sliderReadDoneTask() {
+    bool changed = finishSliderRead();
+
+    // periodic scans are always sent, IRQ scans only if a touch changed
+    // (load generator touches don't come from the reads, so its scans are always sent too)
+    #if LOADGEN
+      changed |= loadGen.isRunning();
     #endif
+    if (changed || !SCAN_IRQ_DRIVEN)
+      sendSliderScan();
+  }
+#endif // SCAN_ASYNC
+
+#if LOADGEN
+  // check whether the load generator should send a report: on every step, or whenever the bus is free when flooding
+  bool loadGenReady() {
+    if (!scanOn || !loadGen.isRunning())
+      return false;
+
+    #if SCAN_ASYNC
+      if (scanReadPending)
+        return false;
+      #if RAW_STREAM
+        if (rawReadPending)
+          return false;
+      #endif
+    #endif
+
+    return (loadGen.getSettings().flags & LOADGEN_FLAG_FLOOD) || loadGen.stepDue();
   }
 
+  // scan and send a report with the load generator's touches (only runs when loadGenReady)
+  // this goes through the same reads as a normal scan, so the report costs the same as a real one
+  void loadGenTask() {
+    PROBE_START(PROBE_REPORT);
 
+    unsigned long steps = loadGen.update();
+    if (steps > 1)
+      loadGenStats.skippedSteps += steps - 1;
+
+    #if SLIDER_LEDS
+      if (steps && (loadGen.getSettings().flags & LOADGEN_FLAG_LEDS)) {
+        byte ledData[LED_PACKET_MAX_LENGTH];
+        loadGen.fillLeds(ledData, SLIDER_BOARDS_MAX_LEDS);
+        applyLedPacket(ledData, sizeof(ledData));
+      }
+    #endif // SLIDER_LEDS
+
+    #if SCAN_ASYNC
+      startSliderRead(false); // sent by sliderReadDoneTask
+    #else
+      doSliderScan();
+    #endif
+  }
+#endif // LOADGEN
+
+#if BUTTON_INPUT
+  // if scanning is on, update buttons
+  void buttonTask() {
+    if (scanOn)
+      doButtonScan();
+  }
+#endif // BUTTON_INPUT
+
+#if SLIDER_LEDS
+  // when the last frame could first be shown (its arrival, or one frame time after the one before)
+  // counting from this rather than when it was actually shown means a frame held up by a deferral doesn't hold up the next one too
+  unsigned long lastLedFrameMicros;
+
+  // check whether there's a new LED frame, and the last one was at least 1/LED_MAX_FPS ago
+  bool ledReady() {
+    return ledUpdate && (micros() - lastLedFrameMicros) >= LED_FRAME_MICROS;
+  }
+
+  // push new LED data to the strip (only runs when ledReady, so identical frames are never shown again)
+  void ledTask() {
+    // 5V is LED voltage, not arduino voltage
+    // working this out here means it's done once per new frame rather than inside every FastLED.show()
+    FastLED.setBrightness(calculate_max_brightness_for_power_mW(sliderLeds, NUM_SLIDER_LEDS, ledBrightness, 5 * RGB_POWER_LIMIT));
+    if (ledUpdateMicros - lastLedFrameMicros >= LED_FRAME_MICROS)
+      lastLedFrameMicros = ledUpdateMicros; // the strip was idle when this frame arrived
+    else
+      lastLedFrameMicros += LED_FRAME_MICROS;
+    PROBE_START(PROBE_LED_SHOW);
+    FastLED.show();
+    PROBE_STOP(PROBE_LED_SHOW);
+    ledUpdate = false;
+  }
+#endif // SLIDER_LEDS
+
+// show errors since the last update on the status leds, then clear them
+void statusLedTask() {
   // set status leds
   if (STATUS_LED_BASIC_1_ERRORS & curError) {
     #ifdef STATUS_LED_BASIC_1_USES_RXTX
@@ -478,11 +1665,64 @@ void loop() {
     digitalWrite(STATUS_LED_BASIC_2_PIN, HIGH);
   }
 
+  // clear errors (they'll be reset if necessary)
+  curError = ERRORSTATE_NONE;
+}
+
+
+// main loop tasks, in priority order
+// (deferrable tasks are skipped if they'd make a non-deferrable task late)
+schedulerTask loopTasks[] = {
+  // run, periodMicros, ready, deferrable
+  { serialTask, 0, NULL, false },
+  #if SCAN_ASYNC
+    { sliderReadDoneTask, 0, sliderReadDoneReady, false },
+  #endif
+  #if SCAN_IRQ_DRIVEN
+    { sliderScanTask, 0, sliderScanReady, false },
+  #else
+    { sliderScanTask, SCAN_INTERVAL_MS * 1000UL, sliderScanReady, false },
+  #endif
+  #if LOADGEN
+    { loadGenTask, 0, loadGenReady, false },
+  #endif
+  #if BUTTON_INPUT
+    { buttonTask, 0, NULL, false },
+  #endif
+  #if RAW_STREAM
+    #if SCAN_ASYNC
+      { rawReadDoneTask, 0, rawReadDoneReady, false },
+    #endif
+    { rawStreamTask, RAW_STREAM_INTERVAL_MS * 1000UL, rawStreamReady, true },
+  #endif
+  #if SLIDER_LEDS
+    { ledTask, 0, ledReady, true },
+  #endif
+  { statusLedTask, STATUS_LED_PERIOD_MS * 1000UL, NULL, true },
+};
+#if SCAN_ASYNC
+  taskScheduler scheduler(loopTasks, sizeof(loopTasks) / sizeof(loopTasks[0]), pollMprBus);
+#else
+  taskScheduler scheduler(loopTasks, sizeof(loopTasks) / sizeof(loopTasks[0]));
+#endif
+
+void loop() {
+  PROBE_STOP(PROBE_LOOP);
+  PROBE_START(PROBE_LOOP);
+
+  scheduler.runOnce();
+
   loopCount++;
 
+  #if LOADGEN
+    if (loadGen.isRunning()) {
+      loadGenStats.loops++;
+      loadGenStats.overruns = scheduler.totalOverruns();
+      loadGenStats.deferrals = scheduler.totalDeferrals();
+    }
+  #endif // LOADGEN
+
   #if FAKE_DATA && FAKE_DATA_TYPE == FAKE_DATA_TYPE_TIMERS
     loopTimer.log();
   #endif
-
-  delayMicroseconds(sleepTime);
 }
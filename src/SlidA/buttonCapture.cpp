@@ -0,0 +1,80 @@
+#include "buttonCapture.h"
+
+// the running capture, for the ISRs
+static buttonCapture* isrCapture = NULL;
+
+#if BUTTON_CAPTURE_INTERRUPTS
+  // PCICR bits for the pins that have pin change interrupts
+  static byte pcintGroups = 0;
+#endif
+
+void buttonCapture::addPin(byte pin) {
+  if (numPins >= BUTTON_CAPTURE_MAX_PINS)
+    return;
+
+  pins[numPins].inputReg = portInputRegister(digitalPinToPort(pin));
+  pins[numPins].bitMask = digitalPinToBitMask(pin);
+  numPins++;
+
+  #if BUTTON_CAPTURE_INTERRUPTS
+    if (digitalPinToPCICR(pin)) {
+      *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+      pcintGroups |= _BV(digitalPinToPCICRbit(pin));
+    }
+    else {
+      needsTimer = true;
+    }
+  #endif // BUTTON_CAPTURE_INTERRUPTS
+}
+
+void buttonCapture::begin() {
+  lastSample = read();
+  isrCapture = this;
+
+  #if BUTTON_CAPTURE_INTERRUPTS
+    PCIFR = pcintGroups; // clear anything from before
+    PCICR |= pcintGroups;
+
+    if (needsTimer) {
+      // Timer3 in CTC mode at clk/8, interrupting every BUTTON_SAMPLE_US
+      TCCR3A = 0;
+      TCCR3B = _BV(WGM32) | _BV(CS31);
+      OCR3A = (F_CPU / 8 / 1000000UL) * BUTTON_SAMPLE_US - 1;
+      TCNT3 = 0;
+      TIMSK3 |= _BV(OCIE3A);
+    }
+  #endif // BUTTON_CAPTURE_INTERRUPTS
+}
+
+byte buttonCapture::read() {
+  byte buttons = 0;
+  for (byte i = 0; i < numPins; i++) {
+    if (!(*pins[i].inputReg & pins[i].bitMask)) // LOW is pressed
+      buttons |= 1 << i;
+  }
+  return buttons;
+}
+
+void buttonCapture::sample() {
+  byte buttons = read();
+  if (buttons == lastSample)
+    return;
+  lastSample = buttons;
+
+  buttonEvent event = { micros(), buttons };
+  if (!events.push(event))
+    dropped++;
+}
+
+#if BUTTON_CAPTURE_INTERRUPTS
+  // the 32u4 only has the one pin change group (port B)
+  ISR(PCINT0_vect) {
+    if (isrCapture)
+      isrCapture->sample();
+  }
+
+  ISR(TIMER3_COMPA_vect) {
+    if (isrCapture)
+      isrCapture->sample();
+  }
+#endif // BUTTON_CAPTURE_INTERRUPTS
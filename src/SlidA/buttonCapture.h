@@ -0,0 +1,74 @@
+/*
+ * interrupt driven button capture
+ *
+ * button states are sampled in ISRs and every change goes into a ring buffer with its time,
+ * so edges are seen when they happen instead of whenever the main loop gets to the buttons:
+ *   - pins with a pin change interrupt (PB0-PB7 on the 32u4, ie. pins 8-11 and 14-17) are captured instantly
+ *   - every other pin is caught by a Timer3 sampling interrupt every BUTTON_SAMPLE_US
+ * each sample reads all the buttons, so events always hold the full state
+ *
+ * the main loop drains events with peek()/pop() (see spscRing.h)
+ * without the AVR registers (eg. host builds), there are no interrupts and sample() has to be called instead
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "spscRing.h"
+
+#define BUTTON_CAPTURE_MAX_PINS 8
+
+// events that can be waiting (power of 2)
+#define BUTTON_CAPTURE_QUEUE 16
+
+// sampling period for pins without pin change interrupts
+#define BUTTON_SAMPLE_US 250
+
+#if defined(PCICR) && defined(TCCR3B)
+  #define BUTTON_CAPTURE_INTERRUPTS true
+#else
+  #define BUTTON_CAPTURE_INTERRUPTS false
+#endif
+
+struct buttonEvent {
+  unsigned long micros; // when the change was seen
+  byte buttons; // pressed buttons (bit n is the nth added pin)
+};
+
+class buttonCapture {
+private:
+  struct pinInput {
+    volatile uint8_t* inputReg;
+    uint8_t bitMask;
+  };
+
+  pinInput pins[BUTTON_CAPTURE_MAX_PINS];
+  byte numPins = 0;
+  bool needsTimer = false;
+
+  byte lastSample = 0; // only used from sample()
+  spscRing<buttonEvent, BUTTON_CAPTURE_QUEUE> events;
+
+public:
+  // events lost because the queue was full (a read() afterwards still gives the right state)
+  volatile unsigned long dropped = 0;
+
+  // add an active low (INPUT_PULLUP) button pin, before begin()
+  void addPin(byte pin);
+
+  // start capturing (only one buttonCapture can be running)
+  void begin();
+
+  // current state of every button, read straight from the ports
+  byte read();
+
+  // take a sample and queue an event if anything changed
+  // called from the ISRs, or by the main loop without BUTTON_CAPTURE_INTERRUPTS
+  void sample();
+
+  // oldest waiting event, see spscRing
+  bool peek(buttonEvent &event) { return events.peek(event); }
+  void pop() { events.pop(); }
+
+  // forget every waiting event
+  void flush() { events.flush(); }
+};
@@ -0,0 +1,104 @@
+#include "loadGen.h"
+
+// start a run with `newSettings` from step 0
+void loadGenerator::start(const loadGenSettings &newSettings) {
+  settings = newSettings;
+  if (settings.fingers == 0)
+    settings.fingers = 1;
+
+  stepMicros = settings.stepHz ? 1000000UL / settings.stepHz : 0;
+  nextStepMicros = micros() + stepMicros;
+  step = 0;
+
+  startMillis = millis();
+  running = true;
+}
+
+void loadGenerator::stop() {
+  if (running) {
+    stopMillis = millis();
+    running = false;
+  }
+}
+
+unsigned long loadGenerator::getElapsedMillis() const {
+  return (running ? millis() : stopMillis) - startMillis;
+}
+
+// move the pattern on to the current step
+// returns how many steps it moved (more than 1 if steps were missed)
+unsigned long loadGenerator::update() {
+  if (!stepDue())
+    return 0;
+
+  // skip straight to the current step, keeping to the original step times
+  unsigned long steps = (micros() - nextStepMicros) / stepMicros + 1;
+  step += steps;
+  nextStepMicros += steps * stepMicros;
+  return steps;
+}
+
+// fill touches (12 bits per mpr, like sliderTouches) with the current step of the pattern
+void loadGenerator::fillTouches(uint16_t* touches, byte numMprs) const {
+  memset(touches, 0, numMprs * sizeof(uint16_t));
+  byte inputs = 12 * numMprs;
+  byte fingers = min(settings.fingers, inputs);
+
+  switch (settings.pattern) {
+    case LOADGEN_GLISSANDO: {
+      byte spacing = inputs / fingers;
+      byte first = step % inputs;
+      for (byte i = 0; i < fingers; i++) {
+        byte input = (first + i * spacing) % inputs;
+        bitSet(touches[input / 12], input % 12);
+      }
+      break;
+    }
+
+    case LOADGEN_SLAM:
+      if (step % 2 == 0) {
+        for (byte i = 0; i < numMprs; i++)
+          touches[i] = 0x0FFF;
+      }
+      break;
+
+    case LOADGEN_TAPS:
+      if (step % 2 == 0) {
+        // xorshift seeded from the tap number, so every tap lands in the same places every run
+        // (fingers can land on the same input, so sometimes fewer inputs are down)
+        uint32_t x = (step / 2) * 2654435761UL + 1;
+        for (byte i = 0; i < fingers; i++) {
+          x ^= x << 13;
+          x ^= x >> 17;
+          x ^= x << 5;
+          byte input = x % inputs;
+          bitSet(touches[input / 12], input % 12);
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+// fill analog values (one per hw input, like mprAnalog) with the current step: 0xC0 touched, 0 not
+void loadGenerator::fillAnalog(byte* values, byte numMprs) const {
+  uint16_t touches[SLIDER_BOARDS_MAX_MPRS];
+  fillTouches(touches, numMprs);
+  for (byte i = 0; i < 12 * numMprs; i++)
+    values[i] = bitRead(touches[i / 12], i % 12) ? 0xC0 : 0;
+}
+
+// fill SLIDER_LED data (brightness, then BRG for numLeds LEDs) with a colour gradient that moves each step
+// every LED changes on every step, so each one is a new frame to show
+void loadGenerator::fillLeds(byte* data, byte numLeds) const {
+  data[0] = 0x3F; // full brightness
+  byte* led = &data[1];
+  for (byte i = 0; i < numLeds; i++, led += 3) {
+    byte level = (step + i) * 8;
+    led[0] = 0;
+    led[1] = level;
+    led[2] = 0xFF - level;
+  }
+}
@@ -0,0 +1,94 @@
+/*
+ * synthetic touch load for stress testing the report path (SLIDER_LOADGEN, see readme)
+ *
+ * while a run is going, scan reports carry generated touches instead of the ones read from the mprs
+ * (the mprs are still read as normal, so the I2C, remap and send costs are all real)
+ * the pattern only depends on the step number, so a run with the same settings gives the same touches every time:
+ *   LOADGEN_GLISSANDO  `fingers` touches spread evenly over the inputs, all moving up one input each step
+ *   LOADGEN_SLAM       every input down for a step, then every input up for a step
+ *   LOADGEN_TAPS       `fingers` pseudo-random inputs down for a step, then every input up for a step
+ * touches are on hw inputs (bit n of mpr m is input 12m + n), so they go through the board profile's remap like real ones
+ *
+ * a report is sent on every step, or back to back with LOADGEN_FLAG_FLOOD to find the highest sustainable rate
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "sliderdefs.h"
+
+enum loadGenPattern : byte {
+  LOADGEN_OFF = 0,
+  LOADGEN_GLISSANDO = 1,
+  LOADGEN_SLAM = 2,
+  LOADGEN_TAPS = 3,
+  NUM_LOADGEN_PATTERNS
+};
+
+#define LOADGEN_FLAG_FLOOD 0x01 // send reports as fast as possible, rather than once per step
+#define LOADGEN_FLAG_LEDS 0x02 // also send a new LED frame to the strip on every step
+
+// SLIDER_LOADGEN request data (all values little endian)
+struct __attribute__((packed)) loadGenSettings {
+  byte pattern; // loadGenPattern
+  byte fingers; // for LOADGEN_GLISSANDO and LOADGEN_TAPS (0 is treated as 1)
+  byte flags; // LOADGEN_FLAG_*
+  uint16_t stepHz; // pattern steps per second (0 = the pattern never moves)
+};
+
+// SLIDER_LOADGEN response data (all values little endian)
+// counters are from the start of the current run (or the last one, if it has stopped)
+struct __attribute__((packed)) loadGenReport {
+  byte running;
+  loadGenSettings settings;
+  uint32_t elapsedMillis;
+  uint32_t steps; // pattern steps
+  uint32_t skippedSteps; // steps that went by without a report (the report path couldn't keep up)
+  uint32_t reports; // scan reports sent
+  uint32_t sendFailures; // scan reports that couldn't be sent (ERRORSTATE_SERIAL_SEND_FAILURE)
+  uint32_t loops; // main loop passes
+  uint32_t overruns; // scheduler task overruns (see taskScheduler.h)
+  uint32_t deferrals; // scheduler task deferrals
+};
+
+static_assert(sizeof(loadGenReport) <= SLIDER_SERIAL_SEND_MAX_DATA, "load generator report too long");
+
+class loadGenerator {
+private:
+  loadGenSettings settings;
+  bool running = false;
+
+  unsigned long stepMicros; // 0 if the pattern doesn't step
+  unsigned long nextStepMicros;
+  unsigned long step;
+
+  unsigned long startMillis;
+  unsigned long stopMillis;
+
+public:
+  // start a run with `newSettings` from step 0 (pattern must be a valid loadGenPattern other than LOADGEN_OFF)
+  void start(const loadGenSettings &newSettings);
+  void stop();
+
+  bool isRunning() const { return running; }
+  const loadGenSettings &getSettings() const { return settings; }
+  unsigned long getStep() const { return step; }
+  unsigned long getElapsedMillis() const;
+
+  // whether the pattern is due to move on
+  bool stepDue() const {
+    return running && stepMicros != 0 && (long)(micros() - nextStepMicros) >= 0;
+  }
+
+  // move the pattern on to the current step
+  // returns how many steps it moved (more than 1 if steps were missed)
+  unsigned long update();
+
+  // fill touches (12 bits per mpr, like sliderTouches, up to SLIDER_BOARDS_MAX_MPRS) with the current step of the pattern
+  void fillTouches(uint16_t* touches, byte numMprs) const;
+
+  // fill analog values (one per hw input, like mprAnalog) with the current step: 0xC0 touched, 0 not
+  void fillAnalog(byte* values, byte numMprs) const;
+
+  // fill SLIDER_LED data (brightness, then BRG for numLeds LEDs) with a colour gradient that moves each step
+  void fillLeds(byte* data, byte numLeds) const;
+};
@@ -0,0 +1,133 @@
+#include "mprCalibration.h"
+#include "mprRegs.h"
+
+// settings to try, fastest response first
+// FFI 34 needs a 2ms interval to be sure all 12 conversions fit between samples
+const mprFilterSetting mprCalSettings[MPR_CAL_NUM_SETTINGS] PROGMEM = {
+  { 0, 0, 0 }, // FFI 6,  SFI 4,  1ms -> 4ms
+  { 1, 0, 0 }, // FFI 10, SFI 4,  1ms -> 4ms
+  { 2, 0, 0 }, // FFI 18, SFI 4,  1ms -> 4ms
+  { 2, 1, 0 }, // FFI 18, SFI 6,  1ms -> 6ms
+  { 3, 0, 1 }, // FFI 34, SFI 4,  2ms -> 8ms
+  { 2, 2, 0 }, // FFI 18, SFI 10, 1ms -> 10ms
+  { 3, 1, 1 }, // FFI 34, SFI 6,  2ms -> 12ms
+  { 3, 2, 1 }, // FFI 34, SFI 10, 2ms -> 20ms
+  { 3, 3, 1 }, // FFI 34, SFI 18, 2ms -> 36ms
+};
+
+byte mprSettingResponseMs(const mprFilterSetting &setting) {
+  static const byte sfiSamples[4] = { 4, 6, 10, 18 };
+  return sfiSamples[setting.sfi & 3] << (setting.esi & 7);
+}
+
+// write a filter setting and (optionally) thresholds with the chip stopped, then restore ECR
+static bool writeChipSettings(byte address, const mprFilterSetting &setting, const byte* touchThresholds, const byte* releaseThresholds) {
+  byte ecr;
+  byte config[2]; // CONFIG1, CONFIG2
+  if (!mprReadRegisters(address, MPR121_REG_ECR, &ecr, 1) || !mprReadRegisters(address, MPR121_REG_CONFIG1, config, 2))
+    return false;
+
+  // the MPR121 only accepts config writes in stop mode
+  if (!mprWriteRegister(address, MPR121_REG_ECR, 0))
+    return false;
+
+  bool ok = true;
+  // keep the charge current and time (from autoconfig), just replace the filter fields
+  ok &= mprWriteRegister(address, MPR121_REG_CONFIG1, (setting.ffi << 6) | (config[0] & 0x3F));
+  ok &= mprWriteRegister(address, MPR121_REG_CONFIG2, (config[1] & 0xE0) | (setting.sfi << 3) | setting.esi);
+
+  if (touchThresholds) {
+    for (byte e = 0; e < 12; e++) {
+      ok &= mprWriteRegister(address, MPR121_REG_TOUCH_THRESHOLD + 2 * e, touchThresholds[e]);
+      ok &= mprWriteRegister(address, MPR121_REG_RELEASE_THRESHOLD + 2 * e, releaseThresholds[e]);
+    }
+  }
+
+  ok &= mprWriteRegister(address, MPR121_REG_ECR, ecr);
+  return ok;
+}
+
+bool mprApplyCalibration(byte chipIndex, const mprCalibration &cal) {
+  if (chipIndex >= cal.numChips)
+    return true; // nothing calibrated for this one
+
+  return writeChipSettings(mprAddress(chipIndex), cal.setting, cal.touchThreshold[chipIndex], cal.releaseThreshold[chipIndex]);
+}
+
+// find the highest idle deviation (baseline - filtered data, so the direction a touch moves it) on each electrode
+// samples are a response time apart so each one has mostly new data
+static bool measureNoise(byte numChips, byte responseMs, byte peaks[][12]) {
+  memset(peaks, 0, numChips * 12);
+
+  for (byte sample = 0; sample < MPR_CAL_SAMPLES; sample++) {
+    for (byte chip = 0; chip < numChips; chip++) {
+      byte address = mprAddress(chip);
+      byte filtered[2 * 12];
+      byte baselines[12];
+      if (!mprReadRegisters(address, MPR121_REG_FILTERED_DATA, filtered, sizeof(filtered)) ||
+          !mprReadRegisters(address, MPR121_REG_BASELINE, baselines, sizeof(baselines)))
+        return false;
+
+      for (byte e = 0; e < 12; e++) {
+        int value = (filtered[2 * e] | (filtered[2 * e + 1] << 8)) & 0x3FF;
+        int deviation = (baselines[e] << 2) - value;
+        if (deviation > peaks[chip][e])
+          peaks[chip][e] = min(deviation, 0xFF);
+      }
+    }
+    delay(responseMs);
+  }
+
+  return true;
+}
+
+mprCalResult mprCalibrate(byte numChips, mprCalibration &cal) {
+  if (numChips > MPR_CAL_MAX_CHIPS)
+    numChips = MPR_CAL_MAX_CHIPS;
+
+  mprCalibration result;
+  memset(&result, 0, sizeof(result));
+  result.version = MPR_CALIBRATION_VERSION;
+  result.numChips = numChips;
+
+  bool targetMet = false;
+  for (byte i = 0; i < MPR_CAL_NUM_SETTINGS && !targetMet; i++) {
+    memcpy_P(&result.setting, &mprCalSettings[i], sizeof(mprFilterSetting));
+    result.settingIndex = i;
+
+    for (byte chip = 0; chip < numChips; chip++) {
+      if (!writeChipSettings(mprAddress(chip), result.setting, NULL, NULL))
+        return MPR_CAL_I2C_ERROR;
+    }
+
+    byte responseMs = mprSettingResponseMs(result.setting);
+    delay(max((unsigned long)responseMs * MPR_CAL_SETTLE_RESPONSES, (unsigned long)MPR_CAL_SETTLE_MIN_MS));
+
+    byte peaks[MPR_CAL_MAX_CHIPS][12];
+    if (!measureNoise(numChips, responseMs, peaks))
+      return MPR_CAL_I2C_ERROR;
+
+    byte maxTouch = 0;
+    result.maxNoise = 0;
+    for (byte chip = 0; chip < numChips; chip++) {
+      for (byte e = 0; e < 12; e++) {
+        byte touch = min(peaks[chip][e] + MPR_CAL_TOUCH_MARGIN, 0xFF);
+        result.touchThreshold[chip][e] = touch;
+        result.releaseThreshold[chip][e] = max(touch / 2, 1);
+        result.maxNoise = max(result.maxNoise, peaks[chip][e]);
+        maxTouch = max(maxTouch, touch);
+      }
+    }
+
+    targetMet = (maxTouch <= MPR_CAL_MAX_TOUCH_THRESHOLD);
+  }
+
+  // if nothing met the target, the slowest setting is the least noisy, so keep it
+  for (byte chip = 0; chip < numChips; chip++) {
+    if (!mprApplyCalibration(chip, result))
+      return MPR_CAL_I2C_ERROR;
+  }
+  cal = result;
+
+  return targetMet ? MPR_CAL_OK : MPR_CAL_TOO_NOISY;
+}
@@ -0,0 +1,73 @@
+/*
+ * MPR121 filter and threshold calibration
+ *
+ * the chips' response time is set by the second filter and sample interval (SFI samples * ESI),
+ * so faster settings average fewer samples and are noisier. calibration tries the settings in
+ * mprCalSettings from fastest to slowest, measures the idle noise of every electrode with each one,
+ * and keeps the first setting where every electrode gets a usable touch threshold:
+ *   touch threshold = highest idle deviation seen in MPR_CAL_SAMPLES samples + MPR_CAL_TOUCH_MARGIN
+ * (so no false touches were seen in MPR_CAL_SAMPLES samples with MPR_CAL_TOUCH_MARGIN counts to spare)
+ * and the highest touch threshold is no more than MPR_CAL_MAX_TOUCH_THRESHOLD
+ *
+ * the slider mustn't be touched while this runs
+ * settings are written with the chips stopped (ECR 0), then the previous ECR value is restored
+ */
+
+#pragma once
+#include <Arduino.h>
+
+#define MPR_CAL_MAX_CHIPS 8
+
+// idle samples measured per setting (per electrode)
+#define MPR_CAL_SAMPLES 64
+
+// time to let baselines settle after changing settings (in response times, at least MPR_CAL_SETTLE_MIN_MS)
+#define MPR_CAL_SETTLE_RESPONSES 8
+#define MPR_CAL_SETTLE_MIN_MS 50
+
+// counts above the idle noise peak for touch thresholds, release thresholds are half of touch
+#define MPR_CAL_TOUCH_MARGIN 4
+
+// thresholds above this would start missing light touches through the acrylic
+#define MPR_CAL_MAX_TOUCH_THRESHOLD 24
+
+// register field values for one filter/timing setting (see the MPR121 datasheet)
+struct mprFilterSetting {
+  byte ffi; // first filter iterations, CONFIG1 bits 7:6 (6/10/18/34 samples)
+  byte sfi; // second filter iterations, CONFIG2 bits 4:3 (4/6/10/18 samples)
+  byte esi; // electrode sample interval, CONFIG2 bits 2:0 (1 << esi ms)
+};
+
+// number of settings tried by mprCalibrate (the first is what the chips used before calibration existed)
+#define MPR_CAL_NUM_SETTINGS 9
+
+// response time of a setting in ms (SFI samples * ESI)
+byte mprSettingResponseMs(const mprFilterSetting &setting);
+
+#define MPR_CALIBRATION_VERSION 2 // 2: thresholds for up to 8 chips
+
+// calibration results, as saved in EEPROM
+struct mprCalibration {
+  byte version; // MPR_CALIBRATION_VERSION if this holds results
+  byte numChips;
+  byte settingIndex; // into the calibration settings list
+  mprFilterSetting setting;
+  byte maxNoise; // highest idle deviation seen on any electrode with the chosen setting
+  byte touchThreshold[MPR_CAL_MAX_CHIPS][12];
+  byte releaseThreshold[MPR_CAL_MAX_CHIPS][12];
+};
+
+enum mprCalResult : byte {
+  MPR_CAL_OK = 0, // a setting met the noise target
+  MPR_CAL_TOO_NOISY = 1, // nothing met it, the slowest setting is used with its (high) thresholds
+  MPR_CAL_I2C_ERROR = 2, // a chip didn't respond, cal isn't changed
+};
+
+// write the filter setting and thresholds from cal to chip `chipIndex` (at mprAddress(chipIndex))
+// the chip should already be started, it's briefly stopped and keeps its electrode configuration
+// returns false if the chip didn't respond
+bool mprApplyCalibration(byte chipIndex, const mprCalibration &cal);
+
+// run the calibration on the first numChips chips, which must be started and untouched
+// the chips are left running with the chosen setting
+mprCalResult mprCalibrate(byte numChips, mprCalibration &cal);
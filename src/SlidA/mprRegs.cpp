@@ -0,0 +1,73 @@
+#include "mprRegs.h"
+#include <Wire.h>
+
+// most registers copied per transfer by mprCopyConfig (Wire buffers are 32 bytes, including the register)
+#define MPR_COPY_CHUNK 24
+
+softI2c mprSoftBus;
+
+// read len consecutive registers starting from reg
+// returns false if the chip didn't respond with all of them
+bool mprReadRegisters(byte address, byte reg, byte* buf, byte len) {
+  if (address & MPR121_SOFT_BUS)
+    return mprSoftBus.readRegisters(address & ~MPR121_SOFT_BUS, reg, buf, len);
+
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0) // repeated start, the MPR121 needs it to keep the register pointer
+    return false;
+
+  if (Wire.requestFrom(address, len) != len)
+    return false;
+
+  for (byte i = 0; i < len; i++)
+    buf[i] = Wire.read();
+
+  return true;
+}
+
+// write a single register
+// returns false if the chip didn't acknowledge
+bool mprWriteRegister(byte address, byte reg, byte value) {
+  return mprWriteRegisters(address, reg, &value, 1);
+}
+
+// write len consecutive registers starting from reg (len has to fit in the Wire buffer with reg)
+// returns false if the chip didn't acknowledge
+bool mprWriteRegisters(byte address, byte reg, const byte* buf, byte len) {
+  if (address & MPR121_SOFT_BUS)
+    return mprSoftBus.writeRegisters(address & ~MPR121_SOFT_BUS, reg, buf, len);
+
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  Wire.write(buf, len);
+  return Wire.endTransmission() == 0;
+}
+
+// copy len registers from one chip to another, a chunk at a time
+static bool copyRegisters(byte from, byte to, byte reg, byte len) {
+  byte buf[MPR_COPY_CHUNK];
+  while (len > 0) {
+    byte n = min(len, (byte)MPR_COPY_CHUNK);
+    if (!mprReadRegisters(from, reg, buf, n) || !mprWriteRegisters(to, reg, buf, n))
+      return false;
+    reg += n;
+    len -= n;
+  }
+  return true;
+}
+
+// give chip `to` the same settings and electrode configuration as chip `from`
+// for starting chips that QuickMpr121 can't talk to (on the soft bus) the same way as the ones it started
+// returns false if either chip didn't respond
+bool mprCopyConfig(byte from, byte to) {
+  byte ecr;
+  if (!mprReadRegisters(from, MPR121_REG_ECR, &ecr, 1))
+    return false;
+
+  // settings can only be written in stop mode, and ECR goes last to start the chip with them
+  return mprWriteRegister(to, MPR121_REG_ECR, 0) &&
+         copyRegisters(from, to, MPR121_CONFIG_FIRST_REG, MPR121_CONFIG_LAST_REG - MPR121_CONFIG_FIRST_REG + 1) &&
+         copyRegisters(from, to, MPR121_REG_AUTOCONFIG, MPR121_AUTOCONFIG_LEN) &&
+         mprWriteRegister(to, MPR121_REG_ECR, ecr);
+}
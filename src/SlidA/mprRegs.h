@@ -0,0 +1,66 @@
+/*
+ * raw MPR121 register access for things QuickMpr121 doesn't cover
+ * (filtered data/baseline reads, per-electrode thresholds, chips on the software I2C bus)
+ *
+ * register addresses are from the MPR121 datasheet
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "softI2c.h"
+
+// QuickMpr121 assigns addresses in order, starting here (see readme for address straps)
+#define MPR121_FIRST_ADDRESS 0x5A
+
+// the address straps only give 4 addresses, so chips past that go on a second (software) bus
+// addresses with MPR121_SOFT_BUS set are on mprSoftBus instead of Wire
+#define MPR121_ADDRESSES_PER_BUS 4
+#define MPR121_SOFT_BUS 0x80
+
+// address of chip n, with the first MPR121_ADDRESSES_PER_BUS on the hardware bus
+constexpr byte mprAddress(byte chip) {
+  return (chip < MPR121_ADDRESSES_PER_BUS) ? (MPR121_FIRST_ADDRESS + chip) :
+                                             ((MPR121_FIRST_ADDRESS + chip - MPR121_ADDRESSES_PER_BUS) | MPR121_SOFT_BUS);
+}
+
+#define MPR121_REG_TOUCH_STATUS 0x00 // 2 bytes, electrodes 0-11 in the low 12 bits
+#define MPR121_REG_OOR_STATUS 0x02 // 2 bytes
+#define MPR121_REG_FILTERED_DATA 0x04 // 2 bytes per electrode, 10 bit little endian
+#define MPR121_REG_BASELINE 0x1E // 1 byte per electrode, upper 8 of 10 bits
+#define MPR121_REG_TOUCH_THRESHOLD 0x41 // touch/release thresholds alternate, 2 bytes per electrode
+#define MPR121_REG_RELEASE_THRESHOLD 0x42
+#define MPR121_REG_DEBOUNCE 0x5B
+#define MPR121_REG_CONFIG1 0x5C // FFI (7:6), CDC (5:0)
+#define MPR121_REG_CONFIG2 0x5D // CDT (7:5), SFI (4:3), ESI (2:0)
+#define MPR121_REG_ECR 0x5E // electrode configuration, 0 = stop mode
+#define MPR121_REG_AUTOCONFIG 0x7B // 5 bytes: control 0, control 1, USL, LSL, target level
+#define MPR121_REG_SOFT_RESET 0x80 // write 0x63 to reset
+
+// settings registers that QuickMpr121 writes when starting a chip (baseline filters up to CONFIG2, and autoconfig)
+#define MPR121_CONFIG_FIRST_REG 0x2B
+#define MPR121_CONFIG_LAST_REG MPR121_REG_CONFIG2
+#define MPR121_AUTOCONFIG_LEN 5
+
+// touch status + OOR status + filtered data for 12 electrodes, all in one burst
+// (has to stay within the 32 byte Wire buffer)
+#define MPR121_STATUS_AND_DATA_LEN (MPR121_REG_FILTERED_DATA + 2 * 12)
+
+// the software I2C bus (set up with begin before using chips on it)
+extern softI2c mprSoftBus;
+
+// read len consecutive registers starting from reg
+// returns false if the chip didn't respond with all of them
+bool mprReadRegisters(byte address, byte reg, byte* buf, byte len);
+
+// write a single register
+// returns false if the chip didn't acknowledge
+bool mprWriteRegister(byte address, byte reg, byte value);
+
+// write len consecutive registers starting from reg (len has to fit in the Wire buffer with reg)
+// returns false if the chip didn't acknowledge
+bool mprWriteRegisters(byte address, byte reg, const byte* buf, byte len);
+
+// give chip `to` the same settings and electrode configuration as chip `from`
+// for starting chips that QuickMpr121 can't talk to (on the soft bus) the same way as the ones it started
+// returns false if either chip didn't respond
+bool mprCopyConfig(byte from, byte to);
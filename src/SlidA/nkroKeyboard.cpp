@@ -0,0 +1,53 @@
+#include "nkroKeyboard.h"
+#include <HID.h>
+
+static const byte nkroReportDescriptor[] PROGMEM = {
+  0x05, 0x01, // USAGE_PAGE (Generic Desktop)
+  0x09, 0x06, // USAGE (Keyboard)
+  0xA1, 0x01, // COLLECTION (Application)
+  0x85, NKRO_REPORT_ID, //   REPORT_ID
+  0x05, 0x07, //   USAGE_PAGE (Keyboard)
+
+  // modifiers
+  0x19, 0xE0, //   USAGE_MINIMUM (Left Control)
+  0x29, 0xE7, //   USAGE_MAXIMUM (Right GUI)
+  0x15, 0x00, //   LOGICAL_MINIMUM (0)
+  0x25, 0x01, //   LOGICAL_MAXIMUM (1)
+  0x75, 0x01, //   REPORT_SIZE (1)
+  0x95, 0x08, //   REPORT_COUNT (8)
+  0x81, 0x02, //   INPUT (Data,Var,Abs)
+
+  // key bitmap
+  0x19, 0x00, //   USAGE_MINIMUM (0)
+  0x29, NKRO_MAX_USAGE, //   USAGE_MAXIMUM
+  0x95, 8 * (NKRO_REPORT_LEN - 1), //   REPORT_COUNT (bits, padded to whole bytes)
+  0x81, 0x02, //   INPUT (Data,Var,Abs)
+
+  0xC0 // END_COLLECTION
+};
+
+nkroKeyboard::nkroKeyboard() {
+  static HIDSubDescriptor node(nkroReportDescriptor, sizeof(nkroReportDescriptor));
+  HID().AppendDescriptor(&node);
+  clear();
+}
+
+void nkroKeyboard::clear() {
+  memset(report, 0, sizeof(report));
+}
+
+void nkroKeyboard::press(byte usage) {
+  if (usage >= 0xE0 && usage <= 0xE7)
+    report[0] |= 1 << (usage - 0xE0);
+  else if (usage <= NKRO_MAX_USAGE)
+    report[1 + usage / 8] |= 1 << (usage % 8);
+}
+
+bool nkroKeyboard::send() {
+  return HID().SendReport(NKRO_REPORT_ID, report, sizeof(report)) >= 0;
+}
+
+bool nkroKeyboard::releaseAll() {
+  clear();
+  return send();
+}
@@ -0,0 +1,46 @@
+/*
+ * NKRO keyboard for the buttons, through PluggableUSB HID
+ *
+ * the Keyboard library sends a report per press/release call, so buttons pressed together reach the host
+ * in separate USB frames. this sends the whole key state as one bitmap report instead, so a chord is
+ * one report and unchanged state costs nothing.
+ *
+ * keys are HID usage codes (keyboard page), not ASCII:
+ *   a-z = 0x04-0x1D, 1-9 = 0x1E-0x26, 0 = 0x27, return = 0x28, escape = 0x29, space = 0x2C,
+ *   modifiers (left ctrl, shift, alt, gui, then right) = 0xE0-0xE7
+ *
+ * uses the Keyboard library's report ID, so don't use both at once
+ */
+
+#pragma once
+#include <Arduino.h>
+
+#define NKRO_REPORT_ID 2
+
+// highest non-modifier usage in the bitmap (0x2F covers letters, numbers, return, escape, space etc.)
+#define NKRO_MAX_USAGE 0x2F
+
+// modifier byte, then one bit per usage from 0 to NKRO_MAX_USAGE
+#define NKRO_REPORT_LEN (1 + (NKRO_MAX_USAGE + 8) / 8)
+
+class nkroKeyboard {
+private:
+  byte report[NKRO_REPORT_LEN];
+
+public:
+  // registers the HID descriptor, so this must be a global (constructed before USB is attached)
+  nkroKeyboard();
+
+  // start building a new key state with nothing pressed
+  void clear();
+
+  // add a key to the state being built (usages above NKRO_MAX_USAGE that aren't modifiers are ignored)
+  void press(byte usage);
+
+  // send the built state
+  // returns false if it couldn't be sent (eg. USB not ready)
+  bool send();
+
+  // send a state with nothing pressed
+  bool releaseAll();
+};
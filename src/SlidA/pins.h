@@ -7,6 +7,11 @@
 // SDA and SCL use the default hw pins
 #define PIN_SLIDER_IRQ 4
 
+// software I2C bus for mprs past the fourth (any free pins work, both need pullups)
+// the IRQ line is shared with the hw bus chips
+#define PIN_SOFT_SDA 18 // A0
+#define PIN_SOFT_SCL 19 // A1
+
 #define SLIDER_LEDS true
 
 #if SLIDER_LEDS
@@ -20,16 +25,15 @@
 
 #if BUTTON_INPUT
 struct kbInput {
-  const char key;
-  const int pin;
-  bool lastState;
+  const byte usage; // HID keyboard usage code (see nkroKeyboard.h)
+  const byte pin;
 };
 
 kbInput kbButtons[] = {
-  {'w', 5, false},
-  {'a', 6, false},
-  {'s', 7, false},
-  {'d', 8, false},
-  {(char)0xB0, 9, false}, // B0: KEY_RETURN
+  {0x1A, 5}, // w
+  {0x04, 6}, // a
+  {0x16, 7}, // s
+  {0x07, 8}, // d
+  {0x28, 9}, // return
 };
 #endif // BUTTON_INPUT
@@ -0,0 +1,36 @@
+#include "profiler.h"
+
+void latencyHistogram::reset() {
+  memset(counts, 0, sizeof(counts));
+  maxMicros = 0;
+}
+
+// add one time to the histogram
+void latencyHistogram::record(unsigned long us) {
+  if (us > maxMicros)
+    maxMicros = (us > 0xFFFF) ? 0xFFFF : us;
+
+  // find the doubling bucket (a few shifts, cheaper than any division on AVR)
+  byte bucket = 0;
+  unsigned long limit = us >> PROFILER_FIRST_BUCKET_LOG2;
+  while (limit && bucket < PROFILER_BUCKETS - 1) {
+    limit >>= 1;
+    bucket++;
+  }
+
+  if (counts[bucket] == 0xFF) {
+    // halve everything to make room, keeping the distribution shape
+    for (uint8_t &count : counts)
+      count >>= 1;
+  }
+  counts[bucket]++;
+}
+
+// fill the histogram part of a profileReport
+void latencyHistogram::fillReport(profileReport &report) {
+  report.bucketCount = PROFILER_BUCKETS;
+  report.firstBucketLog2 = PROFILER_FIRST_BUCKET_LOG2;
+  report.maxMicros = maxMicros;
+  for (byte i = 0; i < PROFILER_BUCKETS; i++)
+    report.counts[i] = counts[i];
+}
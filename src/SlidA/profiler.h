@@ -0,0 +1,61 @@
+/*
+ * microsecond latency histogram for profiling on real hardware
+ *
+ * times are sorted into PROFILER_BUCKETS doubling buckets:
+ *   bucket 0 is < PROFILER_FIRST_BUCKET_US, bucket 1 is < 2x that, ... and the last bucket is everything above
+ * counts are 8 bit, and saturate by halving every bucket, so the shape of the distribution is kept
+ * (so it's the shape of roughly the last few hundred times, rather than everything since the last reset)
+ * each probe is 16 bytes of RAM: the counts, the max and a start time
+ *
+ * the sketch keeps one of these per named probe and reads them out through SLIDER_PROFILE (see readme)
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "segaSlider.h"
+
+#define PROFILER_BUCKETS 10
+#define PROFILER_FIRST_BUCKET_LOG2 4 // 16us
+#define PROFILER_FIRST_BUCKET_US (1UL << PROFILER_FIRST_BUCKET_LOG2)
+
+// readout format of one probe (sent as SLIDER_PROFILE data, all values little endian)
+#define PROFILER_NAME_LEN 8
+struct __attribute__((packed)) profileReport {
+  byte probe; // index of this probe
+  byte probeCount; // number of probes
+  byte bucketCount; // PROFILER_BUCKETS
+  byte firstBucketLog2; // PROFILER_FIRST_BUCKET_LOG2
+  char name[PROFILER_NAME_LEN]; // padded with spaces
+  uint16_t maxMicros; // longest time recorded (saturates at 65535)
+  uint16_t counts[PROFILER_BUCKETS];
+};
+
+static_assert(sizeof(profileReport) <= SLIDER_SERIAL_SEND_MAX_DATA, "profile report too long");
+
+class latencyHistogram {
+private:
+  uint8_t counts[PROFILER_BUCKETS];
+  uint16_t maxMicros;
+  unsigned long startMicros;
+
+public:
+  latencyHistogram() {
+    reset();
+  }
+
+  void reset();
+
+  // add one time to the histogram
+  void record(unsigned long us);
+
+  // time from start() to stop() is recorded
+  void start() {
+    startMicros = micros();
+  }
+  void stop() {
+    record(micros() - startMicros);
+  }
+
+  // fill the histogram part of a profileReport
+  void fillReport(profileReport &report);
+};
@@ -0,0 +1,29 @@
+#include "rawStream.h"
+
+// pack `count` electrodes of MPR121 filtered data registers (2 bytes each, little endian) as 10 bit values
+void rawPackFiltered(const byte* registers, byte count, byte* out) {
+  memset(out, 0, RAW_PACKED_LEN(count));
+
+  uint16_t bitPos = 0;
+  for (byte i = 0; i < count; i++) {
+    uint16_t value = (registers[2 * i] | (registers[2 * i + 1] << 8)) & 0x3FF;
+
+    // values start at bit 0, 2, 4 or 6 of a byte, so each one covers exactly 2 bytes
+    byte* dest = &out[bitPos / 8];
+    byte shift = bitPos % 8;
+    dest[0] |= value << shift;
+    dest[1] |= value >> (8 - shift);
+    bitPos += 10;
+  }
+}
+
+// unpack `count` 10 bit values
+void rawUnpack10(const byte* packed, byte count, uint16_t* out) {
+  uint16_t bitPos = 0;
+  for (byte i = 0; i < count; i++) {
+    const byte* src = &packed[bitPos / 8];
+    byte shift = bitPos % 8;
+    out[i] = ((src[0] | (src[1] << 8)) >> shift) & 0x3FF;
+    bitPos += 10;
+  }
+}
@@ -0,0 +1,30 @@
+/*
+ * raw MPR121 electrode data for the diagnostic stream (SLIDER_SCAN_07 and SLIDER_SCAN_0C, see readme)
+ *
+ * SLIDER_REPORT_06 carries filtered data and SLIDER_REPORT_0B carries baselines, for up to RAW_CHIPS_PER_PACKET
+ * chips each (more chips are sent as more packets):
+ *   [sequence, first chip, chip count, values...]
+ * filtered data is 10 bits per electrode, packed LSB first (electrode n of the packet is bits 10n to 10n+9),
+ * so 3 chips take 45 bytes instead of 72 as register pairs
+ * baselines are one byte per electrode, the upper 8 of 10 bits as the MPR121 stores them
+ * sequence counts stream ticks, and is the same for every packet from one tick
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "segaSlider.h"
+
+#define RAW_CHIPS_PER_PACKET 3
+#define RAW_HEADER_LEN 3
+
+// bytes for `values` packed 10 bit values
+#define RAW_PACKED_LEN(values) (((values) * 10 + 7) / 8)
+
+static_assert(RAW_HEADER_LEN + RAW_PACKED_LEN(12 * RAW_CHIPS_PER_PACKET) <= SLIDER_REPORT_06_MAX_DATA, "filtered data packet too long");
+static_assert(RAW_HEADER_LEN + 12 * RAW_CHIPS_PER_PACKET <= SLIDER_REPORT_0B_MAX_DATA, "baseline packet too long");
+
+// pack `count` electrodes of MPR121 filtered data registers (2 bytes each, little endian) as 10 bit values
+void rawPackFiltered(const byte* registers, byte count, byte* out);
+
+// unpack `count` 10 bit values
+void rawUnpack10(const byte* packed, byte count, uint16_t* out);
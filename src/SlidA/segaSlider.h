@@ -3,7 +3,8 @@
  * used on Project DIVA Arcade: Future Tone and Chunithm.
  * 
  * Requires a dedicated Serial_ or Stream (such as `Serial`) to operate.
- * (Stream with a define changed)
+ * segaSlider<Transport, Codec> picks how with policy classes (see sliderTransport.h and the codecs below),
+ * eg. `segaSlider<sliderSerialTransport> slider(&Serial);`
  * 
  * Usage: see thinithm
  * 
@@ -16,51 +17,74 @@
 
 #pragma once
 #include <Arduino.h>
+#include "sliderTransport.h"
 
 #define SLIDER_FRAMING_START 0xFF
 #define SLIDER_FRAMING_ESCAPE 0xFD
 
-#define SLIDER_SERIAL_TEXT_MODE false
-
 // pro micro ~~should only have a 64 byte internal buffer~~
 //   scratch that, USB CDC behaves differently to I thought and it doesn't really buffer like that...
 //   64 bytes is the endpoint size though
 // don't make this larger than 255
 #define SLIDER_SERIAL_BUF_SIZE 200
 
-// use a better(?) check for serial being available
-// pro micro only, and a little hacky
-// trying it because of https://github.com/arduino/ArduinoCore-avr/issues/112 mentioning an issue with UEBCLX reading 0 during transfers
-// (I've observed similar, but it's unclear if it's due to the same cause)
-// this seems to do very little so I'll leave it disabled
-#define SLIDER_SERIAL_RECEIVE_CHECK_RWAL false
+// drop frames as soon as they can't be valid, instead of when the next start byte arrives:
+//   - the length byte is more than the command allows (see maxDataLength in segaSlider.cpp)
+//   - an escape byte isn't followed by an escaped start or escape byte
+//   - the command is 0 (which getPacket can't return)
+// a corrupted frame then never holds back the parser for longer than its own real length,
+// and garbage can't be buffered as the data of a huge frame
+#define SLIDER_CHECK_FRAMES true
+
+// scan report: one byte per sensor
+#define SLIDER_SCAN_REPORT_MAX_DATA 32
+
+// largest LED packet: brightness byte followed by BRG data for 32 LEDs
+#define SLIDER_LED_MAX_DATA (1 + 3 * 32)
+
+// largest SlidA raw electrode data packets (see rawStream.h): header + 3 chips of 10 bit filtered data or 8 bit baselines
+#define SLIDER_REPORT_06_MAX_DATA 48
+#define SLIDER_REPORT_0B_MAX_DATA 39
 
-// wait until X microseconds after last received byte before returning from readSerial
-#define SLIDER_SERIAL_RECEIVE_TIMEOUT_US 650
+// largest data length accepted for commands without a known length (eg. the unknown diva commands)
+#define SLIDER_UNKNOWN_MAX_DATA 32
 
-// wait maximum of X microseconds from starting to receive bytes before returning from readSerial (even if new bytes can still be read)
-#define SLIDER_SERIAL_RECEIVE_MAX_US 4000
+// largest packet data length that sendPacket can encode
+// whole frames are built on the stack, so this is only as big as the biggest packet the board sends (the raw filtered data report)
+// SlidA's own responses are checked against it with static_asserts where they're defined
+#define SLIDER_MAX_OF(a, b) ((a) > (b) ? (a) : (b))
+#define SLIDER_SERIAL_SEND_MAX_DATA SLIDER_MAX_OF(SLIDER_SCAN_REPORT_MAX_DATA, SLIDER_MAX_OF(SLIDER_REPORT_06_MAX_DATA, SLIDER_REPORT_0B_MAX_DATA))
 
-// wait maximum of X ms for there to be enough output capacity to send a packet
-#define SLIDER_SERIAL_SEND_WAIT_MS 5
+// worst case encoded size of a frame: raw start byte, then command, length, data and checksum all escaped
+#define SLIDER_FRAME_MAX_SIZE(dataLength) (1 + 2 * (3 + (dataLength)))
 
-// use a Stream instead of the platform's serial class
-// more portable (eg. can use on HardwareSerial with USB boards), but can't handle all host failures well
-#define SLIDER_USE_STREAM false
+// longest text for one frame byte: up to three digits and a space
+#define SLIDER_TEXT_BYTE_MAX_SIZE 4
+
+// text mode frames are sent in pieces of up to this many chars, rather than built whole
+// (a whole text frame can be over 400 chars, which is too much for the stack and more than a CDC bank can take at once)
+#define SLIDER_TEXT_CHUNK_SIZE SLIDER_CDC_EP_SIZE
 
 // all known valid slider protocol commands (for use in sliderPacket)
+// (new commands the board receives need their data length limit added to maxDataLength in segaSlider.cpp)
 enum sliderCommand {
   SLIDER_SCAN_REPORT = 0x01, // scan results are sent with this command -- 1 byte for each sensor
   SLIDER_LED = 0x02, // set led colours -- 1 byte (0-63?) brightness, followed by BRG data
   SLIDER_SCAN_ON = 0x03, // enable auto scan
   SLIDER_SCAN_OFF = 0x04, // disable auto scan
-  SLIDER_REPORT_06 = 0x06, // some kind of report, looks a lot like 0B (with double length maybe??), so probably related to that (maybe diva only, seems unused)
-  SLIDER_SCAN_07 = 0x07, // seems to be some kind of scan command related to the 06 report (maybe diva only, seems unused)
+  SLIDER_REPORT_06 = 0x06, // some kind of report, looks a lot like 0B (with double length maybe??), so probably related to that (maybe diva only, seems unused) -- SlidA sends raw filtered data with it
+  SLIDER_SCAN_07 = 0x07, // seems to be some kind of scan command related to the 06 report (maybe diva only, seems unused) -- SlidA starts/stops its raw data stream with it
   SLIDER_UNKNOWN_09 = 0x09, // set some kind of parameter?? segatools says this is something about diva LEDs, but those are 0x02 like chuni (maybe diva only)
   SLIDER_UNKNOWN_0A = 0x0A, // set some kind of parameter?? (maybe diva only)
-  SLIDER_REPORT_0B = 0x0B, // some kind of report, maybe related to calibration, doesn't really matter (maybe diva only, seems unused)
-  SLIDER_SCAN_0C = 0x0C, // seems to be some kind of scan command related to the 0b report (maybe diva only, seems unused)
+  SLIDER_REPORT_0B = 0x0B, // some kind of report, maybe related to calibration, doesn't really matter (maybe diva only, seems unused) -- SlidA sends raw baselines with it
+  SLIDER_SCAN_0C = 0x0C, // seems to be some kind of scan command related to the 0b report (maybe diva only, seems unused) -- SlidA sends baselines once
   SLIDER_DETECT = 0x10, // segatools calls this reset, but doesn't seem to actually reset anything in segatools
+  SLIDER_PROFILE = 0xE0, // not part of the sega protocol -- SlidA profiler readout (see readme)
+  SLIDER_SET_PROFILE = 0xE1, // not part of the sega protocol -- select the SlidA board profile (see readme)
+  SLIDER_CALIBRATE = 0xE2, // not part of the sega protocol -- calibrate SlidA's MPR121 settings (see readme)
+  SLIDER_TRACE = 0xE3, // not part of the sega protocol -- SlidA protocol trace readout (see readme)
+  SLIDER_LOADGEN = 0xE4, // not part of the sega protocol -- SlidA synthetic touch load generator (see readme)
+  SLIDER_STATS = 0xE5, // not part of the sega protocol -- SlidA receive statistics (see readme)
   SLIDER_EXCEPTION = 0xEE, // unimportant, but no reason not to include this
   SLIDER_BOARDINFO = 0xF0 // get slider board model, version, etc -- use boardInfo struct
 };
@@ -79,66 +103,311 @@ struct __attribute__((packed)) boardInfo { // packed should be safe because all
   byte unk_11 = 0x64; // unknown purpose -- seems to just be 0x64
 };
 
-class segaSlider {
+static_assert(sizeof(boardInfo) <= SLIDER_SERIAL_SEND_MAX_DATA, "board info too long");
+
+// SLIDER_STATS response data (not part of the sega protocol, all values little endian)
+// everything is counted from when the board started
+struct __attribute__((packed)) sliderRxStats {
+  uint32_t framesDropped; // frames the parser discarded part way through (see getDroppedFrames)
+  uint32_t packetsInvalid; // packets dropped for bad checksums
+  uint32_t ledPacketsCoalesced; // LED packets replaced by a newer one before being applied
+  uint32_t ledPackets; // valid LED packets received
+};
+
+static_assert(sizeof(sliderRxStats) <= SLIDER_SERIAL_SEND_MAX_DATA, "receive statistics too long");
+
+// verify a packet's checksum is valid
+bool sliderCheckPacketSum(const sliderPacket &packet, byte expectedSum);
+
+// encode a whole escaped frame (start, command, length, data, checksum) into out
+// out must hold SLIDER_FRAME_MAX_SIZE(packet.DataLength) bytes
+// returns the encoded length
+byte sliderEncodeFrame(const sliderPacket &packet, byte* out);
+
+// encode one frame byte as text (decimal followed by a space) into out
+// out must hold SLIDER_TEXT_BYTE_MAX_SIZE chars
+// returns the encoded length
+byte sliderEncodeTextByte(byte data, char* out);
+
+
+// incremental frame parser, fed one received (still escaped) byte at a time
+// (this is the same for every transport and codec, so apart from parseByte it's only compiled once)
+class sliderFrameParser {
 private:
-  #if SLIDER_USE_STREAM
-    typedef Stream streamtype;
-  #else
-    typedef decltype(Serial) streamtype;
-  /*
-  #elif defined(USBCON)
-    typedef Serial_ streamtype;
-  #elif defined(CORE_TEENSY)
-    typedef usb_serial_class streamtype;
-  #elif defined(HAVE_HWSERIAL0)
-    typedef HardwareSerial streamtype;
-  #else
-    #error "Platform serial class unknown"
-  */
-  #endif
-  
-  streamtype* serialStream;
+  // states of the incremental frame parser
+  // (the start byte is always accepted, and resets the parser from any state)
+  enum parserState : byte {
+    PARSER_WAIT_START, // discarding bytes until a start byte arrives
+    PARSER_COMMAND,
+    PARSER_LENGTH,
+    PARSER_DATA,
+    PARSER_CHECKSUM
+  };
 
+  parserState rxState = PARSER_WAIT_START;
+  bool rxUnescapeNext = false; // the next byte needs to be unescaped
+  byte rxCommand;
+  byte rxLength;
+  byte rxChecksum;
+  
+  // holds the data of the frame being parsed (framing, command, length and checksum aren't stored)
   byte serialInBuf[SLIDER_SERIAL_BUF_SIZE];
   byte serialInBufPos = 0;
-  bool sendError;
 
-  // some variables are used to convert incoming text to bytes if necessary
-  #if SLIDER_SERIAL_TEXT_MODE
-    char serialTextBuf[8];
-    byte serialTextReadlen = 0; // the number of chars already read into serialTextBuf
-  #endif // SLIDER_SERIAL_TEXT_MODE
-  
-  // sends a single escaped byte. return value is how much to adjust checksum by
-  byte sendEscapedByte(byte data);
+  // frames discarded by the parser (cut off by a new start byte, too long, or badly escaped)
+  unsigned long droppedFrames = 0;
+
+  #if SLIDER_CHECK_FRAMES
+    // largest data length a received command can have
+    static byte maxDataLength(byte command);
+  #endif // SLIDER_CHECK_FRAMES
+
+  // drop the frame being parsed and wait for the next start byte
+  void dropFrame();
+
+public:
+  // feed one received (still escaped) byte to the frame parser
+  // returns true when it completed a frame (the checksum byte was received)
+  bool parseByte(byte val);
+
+  // the last completed frame, with IsValid set from its checksum
+  // the data is replaced as soon as the next frame starts
+  sliderPacket getFrame();
+
+  // a packet with no command and no data (what getPacket returns when no frame is complete)
+  sliderPacket noPacket();
+
+  // number of frames the parser had to discard without completing them
+  unsigned long getDroppedFrames() { return droppedFrames; }
+};
+
+
+// feed one received (still escaped) byte to the frame parser
+// returns true when it completed a frame (the checksum byte was received)
+// (this runs for every received byte, so it's inline in getPacket)
+inline bool sliderFrameParser::parseByte(byte val) {
+  if (val == SLIDER_FRAMING_START) {
+    // start of a new packet -- this always resyncs, even if the last packet was incomplete
+    if (rxState != PARSER_WAIT_START)
+      droppedFrames++;
+    
+    rxState = PARSER_COMMAND;
+    rxUnescapeNext = false;
+    return false;
+  }
+
+  // don't process any real data before finding the start pos
+  if (rxState == PARSER_WAIT_START)
+    return false;
+
+  if (rxUnescapeNext) {
+    // add 1 to val to unescape data
+    val += 1;
+    rxUnescapeNext = false;
+
+    #if SLIDER_CHECK_FRAMES
+      // only the start and escape bytes are ever escaped, so anything else means the frame is corrupt
+      if (val != SLIDER_FRAMING_START && val != SLIDER_FRAMING_ESCAPE) {
+        dropFrame();
+        return false;
+      }
+    #endif // SLIDER_CHECK_FRAMES
+  }
+  else if (val == SLIDER_FRAMING_ESCAPE) {
+    // next byte should be unescaped; discard the escape byte
+    rxUnescapeNext = true;
+    return false;
+  }
+
+  switch (rxState) {
+    case PARSER_COMMAND:
+      rxCommand = val;
+      rxState = PARSER_LENGTH;
+      #if SLIDER_CHECK_FRAMES
+        // getPacket uses command 0 for no packet, so these could never be handled
+        if (rxCommand == 0)
+          dropFrame();
+      #endif // SLIDER_CHECK_FRAMES
+      break;
 
-  // verify a packet's checksum is valid
-  bool checkPacketSum(const sliderPacket packet, byte expectedSum);
+    case PARSER_LENGTH:
+      rxLength = val;
+      serialInBufPos = 0;
+      #if SLIDER_CHECK_FRAMES
+        if (rxLength > maxDataLength(rxCommand) || rxLength > SLIDER_SERIAL_BUF_SIZE)
+      #else // SLIDER_CHECK_FRAMES
+        if (rxLength > SLIDER_SERIAL_BUF_SIZE)
+      #endif // SLIDER_CHECK_FRAMES
+        dropFrame(); // corrupt or can't be stored, so wait for the next packet
+      else if (rxLength == 0)
+        rxState = PARSER_CHECKSUM;
+      else
+        rxState = PARSER_DATA;
+      break;
 
-  #if SLIDER_SERIAL_TEXT_MODE 
-    // tries to read a text "byte" from serial
-    // (returns -1 if needs more data)
-    int tryReadSerialTextByte();
-  #endif // SLIDER_SERIAL_TEXT_MODE 
+    case PARSER_DATA:
+      serialInBuf[serialInBufPos++] = val;
+      if (serialInBufPos == rxLength)
+        rxState = PARSER_CHECKSUM;
+      break;
 
-  // check for serialStream->available() to be true
-  // (or an equivalent function)
-  bool checkReadAvailable();
+    case PARSER_CHECKSUM:
+      rxState = PARSER_WAIT_START;
+      rxChecksum = val;
+      return true;
 
-  // read new serial data into the internal buffer
-  // returns whether new data was available
-  bool readSerial();
+    default:
+      break;
+  }
+
+  return false;
+}
+
+
+// codec policies: how frames look on the wire
+// a codec has
+//   template <class Transport> bool send(const sliderPacket &packet, Transport &transport)
+//                                    encode a frame and write it to transport, returning whether it all went out
+//   bool decode(byte in, byte &val)  turn a received byte into the next frame byte (if any)
+
+// frames as they are, for games
+class sliderBinaryCodec {
+public:
+  // build the whole frame first so it goes out in a single write (one USB transaction on CDC)
+  template <class Transport>
+  bool send(const sliderPacket &packet, Transport &transport) {
+    byte frame[SLIDER_FRAME_MAX_SIZE(SLIDER_SERIAL_SEND_MAX_DATA)];
+    byte frameLen = sliderEncodeFrame(packet, frame);
+    return transport.write(frame, frameLen);
+  }
+
+  bool decode(byte in, byte &val) {
+    val = in;
+    return true;
+  }
+};
+
+// every frame byte in decimal followed by a space, and a newline after each frame, for testing in a serial console
+// (see slider_text_cmds.txt) -- received numbers can be separated by anything that isn't a digit
+class sliderTextCodec {
+private:
+  byte rxTextValue = 0; // value of the number being read (mod 256, same as the old atoi() & 0xFF)
+  bool rxTextDigits = false; // at least one digit of the number has been read
+
+public:
+  // the text is written SLIDER_TEXT_CHUNK_SIZE chars at a time as it's made, so only the binary frame and one chunk
+  // are on the stack (a frame that fails partway through is cut short, which a console reader can live with)
+  template <class Transport>
+  bool send(const sliderPacket &packet, Transport &transport) {
+    byte frame[SLIDER_FRAME_MAX_SIZE(SLIDER_SERIAL_SEND_MAX_DATA)];
+    byte frameLen = sliderEncodeFrame(packet, frame);
+
+    char text[SLIDER_TEXT_CHUNK_SIZE];
+    byte textLen = 0;
+    for (byte i = 0; i < frameLen; i++) {
+      if (textLen + SLIDER_TEXT_BYTE_MAX_SIZE > SLIDER_TEXT_CHUNK_SIZE) {
+        if (!transport.write((const byte*)text, textLen))
+          return false;
+        textLen = 0;
+      }
+      textLen += sliderEncodeTextByte(frame[i], &text[textLen]);
+    }
+
+    if (textLen == SLIDER_TEXT_CHUNK_SIZE) {
+      if (!transport.write((const byte*)text, textLen))
+        return false;
+      textLen = 0;
+    }
+    text[textLen++] = '\n';
+    return transport.write((const byte*)text, textLen);
+  }
+
+  // feed one received char to the decimal number parser
+  // returns true and sets val when a number was ended by a non-digit
+  bool decode(byte in, byte &val) {
+    if (in >= '0' && in <= '9') {
+      rxTextValue = rxTextValue * 10 + (in - '0'); // wraps the same way as the full number mod 256
+      rxTextDigits = true;
+      return false;
+    }
+
+    // anything else (normally a space or newline) ends a number
+    if (!rxTextDigits)
+      return false;
+
+    val = rxTextValue;
+    rxTextValue = 0;
+    rxTextDigits = false;
+    return true;
+  }
+};
+
+// binary or text, switched at runtime with setText (eg. to go to text for a console session without reflashing)
+// costs a branch per byte
+class sliderSwitchableCodec {
+private:
+  sliderBinaryCodec binary;
+  sliderTextCodec text;
+  bool textMode = false;
+
+public:
+  // switch codecs (a partly received number is dropped)
+  void setText(bool on) {
+    textMode = on;
+    text = sliderTextCodec();
+  }
+  bool isText() { return textMode; }
+
+  template <class Transport>
+  bool send(const sliderPacket &packet, Transport &transport) {
+    return textMode ? text.send(packet, transport) : binary.send(packet, transport);
+  }
+  bool decode(byte in, byte &val) {
+    return textMode ? text.decode(in, val) : binary.decode(in, val);
+  }
+};
+
+
+// the protocol over a transport (see sliderTransport.h), with a codec (binary by default)
+template <class Transport, class Codec = sliderBinaryCodec>
+class segaSlider {
+private:
+  Transport transport;
+  Codec codec;
+  sliderFrameParser parser;
   
 public:
-  segaSlider(streamtype* serial = &Serial);
+  segaSlider(const Transport &transport = Transport()) : transport(transport) {}
   
   // sends a slider packet (checksum is calculated automatically)
   // returns whether the packet was successfully sent
-  bool sendPacket(const sliderPacket packet);
+  bool sendPacket(const sliderPacket packet) {
+    if (packet.DataLength > SLIDER_SERIAL_SEND_MAX_DATA)
+      return false;
 
-  // read new serial data and return a slider packet from the serial buffer
+    return codec.send(packet, transport);
+  }
+
+  // read available serial data and return a slider packet as soon as one is complete
+  // never waits for data -- partial frames are kept and resumed on the next call
   // invalid packets will have IsValid set to false
-  // if there was no data or the buffer was incomplete, `Command` will equal `(sliderCommand)0`
+  // if there was no data or the frame is incomplete, `Command` will equal `(sliderCommand)0`
   // the returned packet's data will be replaced when getPacket is called again
-  sliderPacket getPacket();
+  sliderPacket getPacket() {
+    // feed everything available to the parser, but stop as soon as a packet is complete
+    // so the rest stays queued for the next call
+    while (transport.available()) {
+      byte val;
+      if (codec.decode(transport.read(), val) && parser.parseByte(val))
+        return parser.getFrame();
+    }
+    return parser.noPacket();
+  }
+
+  // number of frames the parser had to discard without returning them
+  // (packets with bad checksums aren't included, getPacket returns those with IsValid false)
+  unsigned long getDroppedFrames() { return parser.getDroppedFrames(); }
+
+  Transport &getTransport() { return transport; }
+  Codec &getCodec() { return codec; }
 };
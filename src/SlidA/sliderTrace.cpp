@@ -0,0 +1,17 @@
+#include "sliderTrace.h"
+
+byte sliderTrace::copyRecords(byte offset, traceRecord* out, byte maxRecords) {
+  if (offset >= count)
+    return 0;
+
+  byte n = count - offset;
+  if (n > maxRecords)
+    n = maxRecords;
+
+  // the oldest record is at next once the buffer has wrapped, or at 0 before that
+  byte first = (count == TRACE_RECORDS) ? next : 0;
+  for (byte i = 0; i < n; i++)
+    out[i] = records[(first + offset + i) & (TRACE_RECORDS - 1)];
+
+  return n;
+}
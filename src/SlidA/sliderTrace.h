@@ -0,0 +1,82 @@
+/*
+ * compact trace of slider protocol activity, for finding out what happened when a game misbehaves
+ *
+ * the last TRACE_RECORDS events (packets received and sent, scanning changes, serial timeouts) are kept
+ * in a RAM ring buffer as 6 byte records. recording is a micros() call and a few stores, so it can stay on.
+ *
+ * the sketch dumps it over SLIDER_TRACE, and host/tools/trace_dump turns that into a timeline (see readme)
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// records kept (power of 2)
+#define TRACE_RECORDS 32
+
+// record times are deltas from the previous record in ticks of 1 << TRACE_TICK_LOG2 micros,
+// saturating at 0xFFFF (so 16us ticks cover gaps of up to ~1s)
+#define TRACE_TICK_LOG2 4
+
+enum traceEvent : byte {
+  TRACE_RX = 1, // packet received (TRACE_FLAG_OK if its checksum was valid)
+  TRACE_TX = 2, // packet sent (TRACE_FLAG_OK if sendPacket succeeded)
+  TRACE_SCAN_ON = 3, // scanning started
+  TRACE_SCAN_OFF = 4, // scanning stopped
+  TRACE_SERIAL_TIMEOUT = 5, // nothing received for SERIAL_TIMEOUT_MS
+};
+#define TRACE_EVENT_MASK 0x07
+#define TRACE_FLAG_OK 0x08
+
+struct __attribute__((packed)) traceRecord {
+  uint16_t ticks; // time since the previous record (little endian)
+  byte event; // traceEvent and flags
+  byte command; // packet command (0 if not a packet)
+  byte length; // packet data length
+  byte errors; // the sketch's error state when this was recorded
+};
+
+class sliderTrace {
+  static_assert(TRACE_RECORDS <= 128 && (TRACE_RECORDS & (TRACE_RECORDS - 1)) == 0, "TRACE_RECORDS must be a power of 2, up to 128");
+
+private:
+  traceRecord records[TRACE_RECORDS];
+  byte next = 0; // where the next record goes
+  byte count = 0; // valid records (up to TRACE_RECORDS)
+  unsigned long lastTick = 0;
+  bool frozen = false;
+
+public:
+  // add a record, replacing the oldest one if the buffer is full (ignored while frozen)
+  void record(byte event, byte command, byte length, byte errors) {
+    if (frozen)
+      return;
+
+    unsigned long now = micros() >> TRACE_TICK_LOG2;
+    unsigned long delta = now - lastTick;
+    lastTick = now;
+
+    traceRecord &r = records[next];
+    r.ticks = delta > 0xFFFF ? 0xFFFF : delta;
+    r.event = event;
+    r.command = command;
+    r.length = length;
+    r.errors = errors;
+
+    next = (next + 1) & (TRACE_RECORDS - 1);
+    if (count < TRACE_RECORDS)
+      count++;
+  }
+
+  // stop or restart recording (so a dump isn't changed while it's read out)
+  void freeze(bool on) {
+    frozen = on;
+  }
+
+  byte getCount() {
+    return count;
+  }
+
+  // copy up to maxRecords records to out, starting from `offset` (0 is the oldest)
+  // returns the number copied
+  byte copyRecords(byte offset, traceRecord* out, byte maxRecords);
+};
@@ -0,0 +1,46 @@
+#include "sliderTransport.h"
+
+#if defined(USBCON) && defined(RWAL)
+  // check the CDC OUT endpoint's RWAL (read/write allowed) flag instead of Serial.available()
+  bool sliderRwalTransport::available() {
+    // pieced together from parts of USBCore.cpp
+    // hopefully it's fine
+    byte _sreg = SREG; // store SREG
+    cli(); // disable interrupts
+    UENUM = (CDC_RX & 7); // select endpoint
+    bool res = UEINTX & (1<<RWAL); // get RWAL (read/write allowed flag)
+    SREG = _sreg; // restore SREG
+    return res;
+  }
+#endif // defined(USBCON) && defined(RWAL)
+
+#if defined(USBCON) && defined(UEDATX)
+  // refill rxChunk with everything in the CDC OUT endpoint's current bank, and release the bank
+  // returns false if there was no data
+  // (the same steps as USB_Recv in USBCore.cpp, but for a whole bank at once)
+  bool sliderEndpointTransport::readEndpoint() {
+    byte _sreg = SREG; // store SREG
+    cli(); // disable interrupts
+    UENUM = (CDC_RX & 7); // select endpoint
+
+    byte len = 0;
+    if (UEINTX & (1<<RXOUTI)) { // a bank holds a received packet
+      len = UEBCLX;
+      if (len > SLIDER_CDC_EP_SIZE)
+        len = SLIDER_CDC_EP_SIZE; // can't happen with a 64 byte endpoint, but don't overrun rxChunk
+
+      for (byte i = 0; i < len; i++)
+        rxChunk[i] = UEDATX;
+
+      // release the bank once it's empty (this also drops zero length packets, which USB_Recv never does)
+      if (UEBCLX == 0)
+        UEINTX = 0x6B; // FIFOCON=0 NAKINI=1 RWAL=1 NAKOUTI=0 RXSTPI=1 RXOUTI=0 STALLEDI=1 TXINI=1
+    }
+
+    SREG = _sreg; // restore SREG
+
+    rxChunkLen = len;
+    rxChunkPos = 0;
+    return len > 0;
+  }
+#endif // defined(USBCON) && defined(UEDATX)
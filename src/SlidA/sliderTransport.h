@@ -0,0 +1,154 @@
+/*
+ * transport policies for segaSlider: where received bytes come from and where encoded frames go
+ *
+ * a transport has
+ *   bool available()                          whether read() has a byte
+ *   byte read()
+ *   bool write(const byte* buf, unsigned int len)   send a whole frame, returning whether it all went out
+ * segaSlider calls these directly rather than through virtual functions, so only the transport that's used
+ * is compiled in, and everything it doesn't do (eg. send waits) isn't there at all
+ *
+ *   sliderSerialTransport    the platform's serial class (Serial_ on USB boards), waiting for room for whole frames
+ *   sliderRwalTransport      sliderSerialTransport, checking the CDC endpoint's RWAL flag for received data (USB AVRs only)
+ *   sliderEndpointTransport  sliderSerialTransport, reading received data straight from the CDC endpoint (USB AVRs only)
+ *   sliderStreamTransport    any Stream (eg. a HardwareSerial on a USB board), more portable but can't handle all host failures well
+ *   sliderMemoryTransport    in-memory buffers, for host tests and benchmarks
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// wait maximum of X ms for there to be enough output capacity to send a packet (or each piece of a long one)
+#define SLIDER_SERIAL_SEND_WAIT_MS 5
+
+// CDC endpoint bank size
+// (on USB AVRs this is the most availableForWrite ever reports, so longer writes are split into pieces this big)
+#define SLIDER_CDC_EP_SIZE 64
+
+class sliderSerialTransport {
+protected:
+  // Serial_ on USB AVRs, usb_serial_class on teensy, HardwareSerial on others
+  typedef decltype(Serial) serialType;
+
+  serialType* serialStream;
+
+public:
+  sliderSerialTransport(serialType* serial = &Serial) : serialStream(serial) {}
+
+  bool available() { return serialStream->available(); }
+  byte read() { return serialStream->read(); }
+
+  // make sure the host is ready to receive data and there's space for the whole frame (dropping packets is better than locking)
+  // writes longer than a CDC bank can never fit at once, so they go a bank at a time, waiting for room for each piece
+  // (only text mode and heavily escaped binary frames get that long)
+  bool write(const byte* buf, unsigned int len) {
+    while (len > 0) {
+      unsigned int chunk = min(len, (unsigned int)SLIDER_CDC_EP_SIZE);
+
+      unsigned long startMillis = millis();
+      while (serialStream->availableForWrite() < (int)chunk) {
+        // wait maximum of X ms for there to be enough output capacity to send a packet
+        if (millis() - startMillis >= SLIDER_SERIAL_SEND_WAIT_MS)
+          return false;
+      }
+      if (serialStream->write(buf, chunk) != chunk)
+        return false;
+
+      buf += chunk;
+      len -= chunk;
+    }
+    return true;
+  }
+};
+
+#if defined(USBCON) && defined(RWAL)
+  // a better(?) check for serial being available
+  // pro micro only, and a little hacky
+  // trying it because of https://github.com/arduino/ArduinoCore-avr/issues/112 mentioning an issue with UEBCLX reading 0 during transfers
+  // (I've observed similar, but it's unclear if it's due to the same cause)
+  // this seems to do very little so it isn't used by default
+  class sliderRwalTransport : public sliderSerialTransport {
+  public:
+    using sliderSerialTransport::sliderSerialTransport;
+
+    bool available();
+  };
+#endif // defined(USBCON) && defined(RWAL)
+
+#if defined(USBCON) && defined(UEDATX)
+  // read received data straight from the USB CDC OUT endpoint (32u4 and other native USB AVRs only)
+  // each bank (up to 64 bytes) is copied out in one critical section, instead of an endpoint select
+  // with interrupts off for every available() and read() call
+  // the Serial_ code is bypassed completely, so nothing else may read from Serial (including peek())
+  class sliderEndpointTransport : public sliderSerialTransport {
+  private:
+    // data copied out of the CDC endpoint that hasn't been read yet
+    byte rxChunk[SLIDER_CDC_EP_SIZE];
+    byte rxChunkLen = 0;
+    byte rxChunkPos = 0;
+
+    // refill rxChunk with everything in the CDC OUT endpoint's current bank, and release the bank
+    // returns false if there was no data
+    bool readEndpoint();
+
+  public:
+    using sliderSerialTransport::sliderSerialTransport;
+
+    bool available() { return rxChunkPos < rxChunkLen || readEndpoint(); }
+    byte read() { return rxChunk[rxChunkPos++]; }
+  };
+#endif // defined(USBCON) && defined(UEDATX)
+
+class sliderStreamTransport {
+private:
+  Stream* serialStream;
+
+public:
+  sliderStreamTransport(Stream* stream) : serialStream(stream) {}
+
+  bool available() { return serialStream->available() > 0; }
+  byte read() { return serialStream->read(); }
+  bool write(const byte* buf, unsigned int len) { return serialStream->write(buf, len) == len; }
+};
+
+class sliderMemoryTransport {
+private:
+  const byte* rxData = NULL;
+  size_t rxLength = 0;
+  size_t rxPos = 0;
+
+  byte* txBuf = NULL;
+  size_t txCapacity = 0;
+  size_t txLength = 0;
+
+public:
+  // read from data (anything from before that wasn't read is dropped)
+  void setInput(const byte* data, size_t length) {
+    rxData = data;
+    rxLength = length;
+    rxPos = 0;
+  }
+
+  // write frames into buf (frames that don't fit in what's left fail to send)
+  void setOutput(byte* buf, size_t capacity) {
+    txBuf = buf;
+    txCapacity = capacity;
+    txLength = 0;
+  }
+
+  // input bytes not read yet, and output bytes written
+  size_t inputRemaining() const { return rxLength - rxPos; }
+  size_t outputLength() const { return txLength; }
+  void clearOutput() { txLength = 0; }
+
+  bool available() { return rxPos < rxLength; }
+  byte read() { return rxData[rxPos++]; }
+
+  bool write(const byte* buf, unsigned int len) {
+    if (len > txCapacity - txLength)
+      return false;
+    memcpy(&txBuf[txLength], buf, len);
+    txLength += len;
+    return true;
+  }
+};
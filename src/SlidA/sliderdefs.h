@@ -1,8 +1,9 @@
 /*
- * slider board type defs for thinithm (divaslider)
- * 
- * if adding more in the future it'd probably be a good idea to use PROGMEM,
- * but for now it's not really worth bothering
+ * slider board type defs for SlidA (diva and chunithm layouts)
+ *
+ * defs are constexpr so the key remap (sliderKeyRemap) and LED plan can be worked out at compile time,
+ * then SLIDER_PROFILE turns each one into a sliderProfile for a PROGMEM table
+ * (the defs themselves never end up in RAM or flash)
  */
 
 #pragma once
@@ -12,19 +13,27 @@
 #define SLIDER_BOARDS_MAX_KEYS 32
 #define SLIDER_BOARDS_MAX_LEDS 32
 
+// touch state of every raw hw key is kept as one word per mpr (bit n is electrode n),
+// so raw key r is bit r % 12 of word r / 12
+#define SLIDER_BOARDS_MAX_MPRS 8
+#define SLIDER_BOARDS_MAX_RAW_KEYS (12 * SLIDER_BOARDS_MAX_MPRS)
+
+// marks an unused raw key slot in a keyMap
+#define SLIDER_RAW_NONE 0xFF
+
 struct sliderDef {
   // number of keys in the protocol
   const byte keyCount;
-  
+
   // keyMap is indexed by the protocol output key number
   // it stores the raw hw key numbers that should affect the output
-  //   note: hw numbers assume 48 inputs
-  // allow two raw keys per output to support merging rows
-  const byte keyMap[SLIDER_BOARDS_MAX_KEYS];
-  
+  //   note: hw numbers are 12*mpr + electrode, up to SLIDER_BOARDS_MAX_RAW_KEYS
+  // allow two raw keys per output to support merging rows (unused slots are SLIDER_RAW_NONE)
+  const byte keyMap[SLIDER_BOARDS_MAX_KEYS][2];
+
   // number of LEDs in the protocol
   const byte ledCount;
-  
+
   // ledMap is indexed by the protocol input LED number
   // it stores the raw hw LED number that should take the value
   //   assume 32 hw leds
@@ -36,16 +45,166 @@ struct sliderDef {
   const char chipNumber[sizeof(boardInfo::chipNumber)];
 };
 
-const sliderDef divaSlider =
+constexpr sliderDef divaSlider =
 {
   32,
   {
-    0+0, 0+1, 0+2, 0+3, 0+4, 0+5, 0+6, 0+7, 0+8, 0+9, 0+10, 0+11,
-    1+0, 1+1, 1+2, 1+3, 1+4, 1+5, 1+6, 1+7, 1+8, 1+9, 1+10, 1+11,
-    2+0, 2+1, 2+2, 2+3, 2+4, 2+5, 2+6, 2+7
+    {0+0, SLIDER_RAW_NONE}, {0+1, SLIDER_RAW_NONE}, {0+2, SLIDER_RAW_NONE}, {0+3, SLIDER_RAW_NONE},
+    {0+4, SLIDER_RAW_NONE}, {0+5, SLIDER_RAW_NONE}, {0+6, SLIDER_RAW_NONE}, {0+7, SLIDER_RAW_NONE},
+    {0+8, SLIDER_RAW_NONE}, {0+9, SLIDER_RAW_NONE}, {0+10, SLIDER_RAW_NONE}, {0+11, SLIDER_RAW_NONE},
+    {12+0, SLIDER_RAW_NONE}, {12+1, SLIDER_RAW_NONE}, {12+2, SLIDER_RAW_NONE}, {12+3, SLIDER_RAW_NONE},
+    {12+4, SLIDER_RAW_NONE}, {12+5, SLIDER_RAW_NONE}, {12+6, SLIDER_RAW_NONE}, {12+7, SLIDER_RAW_NONE},
+    {12+8, SLIDER_RAW_NONE}, {12+9, SLIDER_RAW_NONE}, {12+10, SLIDER_RAW_NONE}, {12+11, SLIDER_RAW_NONE},
+    {24+0, SLIDER_RAW_NONE}, {24+1, SLIDER_RAW_NONE}, {24+2, SLIDER_RAW_NONE}, {24+3, SLIDER_RAW_NONE},
+    {24+4, SLIDER_RAW_NONE}, {24+5, SLIDER_RAW_NONE}, {24+6, SLIDER_RAW_NONE}, {24+7, SLIDER_RAW_NONE}
   },
   32,
   { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31 },
   { '1', '5', '2', '7', '5', ' ', ' ', ' ' },
   { '0', '6', '6', '8', '7' }
 };
+
+// chunithm numbers keys from the right, with top and bottom of each column next to each other
+// both rows of a column are merged into the same two hw keys (SlidA only has one row of 32)
+// LEDs also go from the right: 16 keys with 15 separators between them
+constexpr sliderDef chuniSlider =
+{
+  32,
+  {
+    {31, 30}, {31, 30}, {29, 28}, {29, 28}, {27, 26}, {27, 26}, {25, 24}, {25, 24},
+    {23, 22}, {23, 22}, {21, 20}, {21, 20}, {19, 18}, {19, 18}, {17, 16}, {17, 16},
+    {15, 14}, {15, 14}, {13, 12}, {13, 12}, {11, 10}, {11, 10}, {9, 8}, {9, 8},
+    {7, 6}, {7, 6}, {5, 4}, {5, 4}, {3, 2}, {3, 2}, {1, 0}, {1, 0}
+  },
+  31,
+  { 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 },
+  { '1', '5', '3', '3', '0', ' ', ' ', ' ' },
+  { '0', '6', '7', '1', '2' }
+};
+
+// chunithm with both rows fitted (64 hw keys, needs at least 6 mprs)
+// raw keys 0-31 are the top row and 32-63 the bottom row, each numbered from the left like the diva layout
+// each protocol key still covers two hw keys, but top and bottom are separate now
+constexpr sliderDef chuniSliderTwoRow =
+{
+  32,
+  {
+    {31, 30}, {63, 62}, {29, 28}, {61, 60}, {27, 26}, {59, 58}, {25, 24}, {57, 56},
+    {23, 22}, {55, 54}, {21, 20}, {53, 52}, {19, 18}, {51, 50}, {17, 16}, {49, 48},
+    {15, 14}, {47, 46}, {13, 12}, {45, 44}, {11, 10}, {43, 42}, {9, 8}, {41, 40},
+    {7, 6}, {39, 38}, {5, 4}, {37, 36}, {3, 2}, {35, 34}, {1, 0}, {33, 32}
+  },
+  31,
+  { 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 },
+  { '1', '5', '3', '3', '0', ' ', ' ', ' ' },
+  { '0', '6', '7', '1', '2' }
+};
+
+// remap raw hw key state to protocol keys for def, with raw keys from rawCount up ignored
+// this is expanded into one step per key at compile time, so every mask and index is a constant
+// (merged rows are just an OR of their bits, and there are no bounds checks left at runtime)
+//
+// usage: sliderKeyRemap<divaSlider, 36>::touches(mprTouches, out)
+template <const sliderDef &def, byte rawCount, byte key = 0, bool done = (key >= def.keyCount)>
+struct sliderKeyRemap {
+  static_assert(def.keyCount <= SLIDER_BOARDS_MAX_KEYS, "too many keys in slider def");
+  static_assert(rawCount <= SLIDER_BOARDS_MAX_RAW_KEYS, "too many raw keys");
+
+  // set out[key] to 0xC0 if any of its raw keys are touched, 0 otherwise
+  // (mprTouches has a word per mpr, see SLIDER_BOARDS_MAX_RAW_KEYS)
+  static inline void touches(const uint16_t* mprTouches, byte* out) {
+    constexpr byte raw0 = def.keyMap[key][0];
+    constexpr byte raw1 = def.keyMap[key][1];
+
+    bool touched = false;
+    if (raw0 < rawCount)
+      touched = mprTouches[raw0 / 12] & (1 << (raw0 % 12));
+    if (raw1 < rawCount)
+      touched |= (bool)(mprTouches[raw1 / 12] & (1 << (raw1 % 12)));
+    out[key] = touched ? 0xC0 : 0;
+
+    sliderKeyRemap<def, rawCount, key + 1>::touches(mprTouches, out);
+  }
+
+  // set out[key] to the highest analog value of its raw keys (so merged rows stack nicely)
+  static inline void analog(const byte* rawValues, byte* out) {
+    constexpr byte raw0 = def.keyMap[key][0];
+    constexpr byte raw1 = def.keyMap[key][1];
+
+    byte value = 0;
+    if (raw0 < rawCount)
+      value = rawValues[raw0];
+    if (raw1 < rawCount && rawValues[raw1] > value)
+      value = rawValues[raw1];
+    out[key] = value;
+
+    sliderKeyRemap<def, rawCount, key + 1>::analog(rawValues, out);
+  }
+};
+
+// end of the key list
+template <const sliderDef &def, byte rawCount, byte key>
+struct sliderKeyRemap<def, rawCount, key, true> {
+  static inline void touches(const uint16_t* mprTouches, byte* out) {}
+  static inline void analog(const byte* rawValues, byte* out) {}
+};
+
+
+// LED output plan entries (see sliderProfile::ledPlan)
+// the low bits are the output LED, LED_PLAN_DIM marks separators (shown at half brightness)
+#define LED_PLAN_DIM 0x80
+#define LED_PLAN_NONE 0x7F // protocol LED isn't shown
+
+// plan entry for protocol LED `led` of def, with hwLedCount LEDs fitted
+// odd protocol LEDs are the separators between keys
+constexpr byte sliderLedPlanEntry(const sliderDef &def, byte led, byte hwLedCount) {
+  return (led >= def.ledCount || def.ledMap[led] >= hwLedCount) ? LED_PLAN_NONE : // make sure there's no out of bounds writes
+         (led % 2 == 0) ? def.ledMap[led] : (def.ledMap[led] | LED_PLAN_DIM);
+}
+
+// everything needed to run as one board type, stored in PROGMEM
+// (read fields with pgm_read_byte/pgm_read_ptr/memcpy_P)
+struct sliderProfile {
+  // board and chip numbers used in the sega protocol
+  char model[sizeof(boardInfo::model)];
+  char chipNumber[sizeof(boardInfo::chipNumber)];
+
+  // number of keys and LEDs in the protocol
+  byte keyCount;
+  byte ledCount;
+
+  // LED output plan, indexed by protocol LED number
+  // precomputed so applying a frame doesn't need to check bounds or separators per LED
+  byte ledPlan[SLIDER_BOARDS_MAX_LEDS];
+
+  // sliderKeyRemap<def, rawCount> functions
+  void (*remapTouches)(const uint16_t* mprTouches, byte* out);
+  void (*remapAnalog)(const byte* rawValues, byte* out);
+};
+
+#define SLIDER_PROFILE_CHARS_8(a) { a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7] }
+#define SLIDER_PROFILE_CHARS_5(a) { a[0], a[1], a[2], a[3], a[4] }
+#define SLIDER_PROFILE_LED_PLAN(def, hwLedCount) { \
+  sliderLedPlanEntry(def, 0, hwLedCount), sliderLedPlanEntry(def, 1, hwLedCount), sliderLedPlanEntry(def, 2, hwLedCount), sliderLedPlanEntry(def, 3, hwLedCount), \
+  sliderLedPlanEntry(def, 4, hwLedCount), sliderLedPlanEntry(def, 5, hwLedCount), sliderLedPlanEntry(def, 6, hwLedCount), sliderLedPlanEntry(def, 7, hwLedCount), \
+  sliderLedPlanEntry(def, 8, hwLedCount), sliderLedPlanEntry(def, 9, hwLedCount), sliderLedPlanEntry(def, 10, hwLedCount), sliderLedPlanEntry(def, 11, hwLedCount), \
+  sliderLedPlanEntry(def, 12, hwLedCount), sliderLedPlanEntry(def, 13, hwLedCount), sliderLedPlanEntry(def, 14, hwLedCount), sliderLedPlanEntry(def, 15, hwLedCount), \
+  sliderLedPlanEntry(def, 16, hwLedCount), sliderLedPlanEntry(def, 17, hwLedCount), sliderLedPlanEntry(def, 18, hwLedCount), sliderLedPlanEntry(def, 19, hwLedCount), \
+  sliderLedPlanEntry(def, 20, hwLedCount), sliderLedPlanEntry(def, 21, hwLedCount), sliderLedPlanEntry(def, 22, hwLedCount), sliderLedPlanEntry(def, 23, hwLedCount), \
+  sliderLedPlanEntry(def, 24, hwLedCount), sliderLedPlanEntry(def, 25, hwLedCount), sliderLedPlanEntry(def, 26, hwLedCount), sliderLedPlanEntry(def, 27, hwLedCount), \
+  sliderLedPlanEntry(def, 28, hwLedCount), sliderLedPlanEntry(def, 29, hwLedCount), sliderLedPlanEntry(def, 30, hwLedCount), sliderLedPlanEntry(def, 31, hwLedCount) }
+static_assert(SLIDER_BOARDS_MAX_LEDS == 32, "SLIDER_PROFILE_LED_PLAN needs updating");
+static_assert(sizeof(boardInfo::model) == 8 && sizeof(boardInfo::chipNumber) == 5, "SLIDER_PROFILE_CHARS needs updating");
+
+// sliderProfile initializer for def, with rawCount hw keys and hwLedCount hw LEDs fitted
+//
+// usage: const sliderProfile profiles[] PROGMEM = { SLIDER_PROFILE(divaSlider, 36, 32), ... };
+#define SLIDER_PROFILE(def, rawCount, hwLedCount) { \
+  SLIDER_PROFILE_CHARS_8(def.model), \
+  SLIDER_PROFILE_CHARS_5(def.chipNumber), \
+  def.keyCount, \
+  def.ledCount, \
+  SLIDER_PROFILE_LED_PLAN(def, hwLedCount), \
+  sliderKeyRemap<def, rawCount>::touches, \
+  sliderKeyRemap<def, rawCount>::analog \
+}
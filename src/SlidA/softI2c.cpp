@@ -0,0 +1,170 @@
+#include "softI2c.h"
+
+#if SOFT_I2C_PINS
+
+void softI2c::begin(byte sdaPin, byte sclPin) {
+  // PORT low and DDR as input, so the lines are released (high) until pulled
+  sda.modeReg = portModeRegister(digitalPinToPort(sdaPin));
+  sda.inputReg = portInputRegister(digitalPinToPort(sdaPin));
+  sda.bitMask = digitalPinToBitMask(sdaPin);
+  *portOutputRegister(digitalPinToPort(sdaPin)) &= ~sda.bitMask;
+  release(sda);
+
+  scl.modeReg = portModeRegister(digitalPinToPort(sclPin));
+  scl.inputReg = portInputRegister(digitalPinToPort(sclPin));
+  scl.bitMask = digitalPinToBitMask(sclPin);
+  *portOutputRegister(digitalPinToPort(sclPin)) &= ~scl.bitMask;
+  release(scl);
+}
+
+// wait for half a clock, running the hook
+void softI2c::halfBit() {
+  if (idleHook)
+    idleHook();
+  delayMicroseconds(SOFT_I2C_HALF_BIT_US);
+}
+
+void softI2c::start() {
+  release(sda);
+  release(scl);
+  halfBit();
+  pull(sda); // SDA falling while SCL is high
+  halfBit();
+  pull(scl);
+  halfBit();
+}
+
+void softI2c::repeatedStart() {
+  release(sda);
+  halfBit();
+  release(scl);
+  halfBit();
+  pull(sda);
+  halfBit();
+  pull(scl);
+  halfBit();
+}
+
+void softI2c::stop() {
+  pull(sda);
+  halfBit();
+  release(scl);
+  halfBit();
+  release(sda); // SDA rising while SCL is high
+  halfBit();
+}
+
+// returns whether the byte was acknowledged
+bool softI2c::writeByte(byte data) {
+  for (byte bit = 0x80; bit; bit >>= 1) {
+    if (data & bit)
+      release(sda);
+    else
+      pull(sda);
+    halfBit();
+    release(scl);
+    halfBit();
+    pull(scl);
+  }
+
+  // the chip pulls SDA low to acknowledge
+  release(sda);
+  halfBit();
+  release(scl);
+  halfBit();
+  bool ack = !read(sda);
+  pull(scl);
+  return ack;
+}
+
+byte softI2c::readByte(bool ack) {
+  byte data = 0;
+  release(sda);
+  for (byte i = 0; i < 8; i++) {
+    halfBit();
+    release(scl);
+    halfBit();
+    data = (data << 1) | (read(sda) ? 1 : 0);
+    pull(scl);
+  }
+
+  // acknowledge every byte but the last
+  if (ack)
+    pull(sda);
+  halfBit();
+  release(scl);
+  halfBit();
+  pull(scl);
+  release(sda);
+  return data;
+}
+
+// read len consecutive registers starting from reg (with a repeated start, like mprReadRegisters)
+// returns false if the chip didn't acknowledge
+bool softI2c::readRegisters(byte address, byte reg, byte* buf, byte len) {
+  start();
+  bool ok = writeByte(address << 1) && writeByte(reg);
+  if (ok) {
+    repeatedStart(); // the MPR121 needs it to keep the register pointer
+    ok = writeByte((address << 1) | 1);
+    for (byte i = 0; ok && i < len; i++)
+      buf[i] = readByte(i < len - 1);
+  }
+  stop();
+  return ok;
+}
+
+// write len consecutive registers starting from reg
+// returns false if the chip didn't acknowledge
+bool softI2c::writeRegisters(byte address, byte reg, const byte* buf, byte len) {
+  start();
+  bool ok = writeByte(address << 1) && writeByte(reg);
+  for (byte i = 0; ok && i < len; i++)
+    ok = writeByte(buf[i]);
+  stop();
+  return ok;
+}
+
+#else // SOFT_I2C_PINS
+
+#include <Wire.h>
+
+// no port registers, so there are no pins to set up
+void softI2c::begin(byte sdaPin, byte sclPin) {}
+
+// read len consecutive registers starting from reg
+// returns false if the chip didn't acknowledge
+bool softI2c::readRegisters(byte address, byte reg, byte* buf, byte len) {
+  if (idleHook)
+    idleHook();
+
+  Wire.beginTransmission(address | SOFT_I2C_HOST_BUS);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0)
+    return false;
+
+  if (Wire.requestFrom(address | SOFT_I2C_HOST_BUS, len) != len)
+    return false;
+
+  for (byte i = 0; i < len; i++)
+    buf[i] = Wire.read();
+
+  if (idleHook)
+    idleHook();
+  return true;
+}
+
+// write len consecutive registers starting from reg
+// returns false if the chip didn't acknowledge
+bool softI2c::writeRegisters(byte address, byte reg, const byte* buf, byte len) {
+  if (idleHook)
+    idleHook();
+
+  Wire.beginTransmission(address | SOFT_I2C_HOST_BUS);
+  Wire.write(reg);
+  for (byte i = 0; i < len; i++)
+    Wire.write(buf[i]);
+  return Wire.endTransmission() == 0;
+}
+
+#endif // SOFT_I2C_PINS
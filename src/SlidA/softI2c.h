@@ -0,0 +1,75 @@
+/*
+ * bit-banged I2C master on any two pins, for a second MPR121 bus (the 32u4 only has one TWI,
+ * and the MPR121 only has four addresses)
+ *
+ * the lines are driven open drain: low by switching the pin to an output (its PORT bit is kept at 0),
+ * high by switching it back to an input and letting the pullups on the MPR121 boards pull it up
+ * (add 4.7k-10k pullups if the boards don't have them). clock stretching isn't needed for the MPR121.
+ *
+ * the CPU clocks every bit, so transfers block -- but idleHook is called on every clock edge,
+ * which lets the hardware bus (twiAsync::poll) run at the same time
+ * each half clock is the hook, SOFT_I2C_HALF_BIT_US and the pin access, so the bus runs at roughly 140kHz on a 16MHz board
+ * (an estimate -- with twiAsync::poll as the hook that's ~1us, but a hook that calls micros() adds a few us per edge)
+ *
+ * without AVR port registers (eg. host builds), transfers go through Wire to addresses with
+ * SOFT_I2C_HOST_BUS set instead (see the host mprSim)
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// extra delay on every half clock
+#define SOFT_I2C_HALF_BIT_US 2
+
+#if defined(portModeRegister) && defined(portOutputRegister)
+  #define SOFT_I2C_PINS true
+#else
+  #define SOFT_I2C_PINS false
+  #define SOFT_I2C_HOST_BUS 0x80
+#endif
+
+class softI2c {
+private:
+  #if SOFT_I2C_PINS
+    struct openDrainPin {
+      volatile uint8_t* modeReg;
+      volatile uint8_t* inputReg;
+      uint8_t bitMask;
+    };
+
+    openDrainPin sda;
+    openDrainPin scl;
+
+    void pull(openDrainPin &pin) { *pin.modeReg |= pin.bitMask; }
+    void release(openDrainPin &pin) { *pin.modeReg &= ~pin.bitMask; }
+    bool read(openDrainPin &pin) { return *pin.inputReg & pin.bitMask; }
+
+    // wait for half a clock, running the hook
+    void halfBit();
+
+    void start();
+    void repeatedStart();
+    void stop();
+
+    // returns whether the byte was acknowledged
+    bool writeByte(byte data);
+    byte readByte(bool ack);
+  #endif // SOFT_I2C_PINS
+
+  void (*idleHook)() = NULL;
+
+public:
+  // set up the bus pins (released, so both lines are pulled high)
+  void begin(byte sdaPin, byte sclPin);
+
+  // call hook on every clock edge (NULL for none)
+  void setIdleHook(void (*hook)()) { idleHook = hook; }
+
+  // read len consecutive registers starting from reg (with a repeated start, like mprReadRegisters)
+  // returns false if the chip didn't acknowledge
+  bool readRegisters(byte address, byte reg, byte* buf, byte len);
+
+  // write len consecutive registers starting from reg
+  // returns false if the chip didn't acknowledge
+  bool writeRegisters(byte address, byte reg, const byte* buf, byte len);
+};
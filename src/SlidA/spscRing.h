@@ -0,0 +1,64 @@
+/*
+ * lock-free single producer, single consumer ring buffer
+ *
+ * for passing data out of an ISR: the ISR only pushes and the main loop only peeks/pops,
+ * so neither side needs to disable interrupts. indices are single bytes, which AVR reads and writes atomically.
+ * one side's index is only written after its item copy is done (the compiler barriers keep that order).
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// stop the compiler moving memory accesses across this point
+#define SPSC_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+template <typename T, byte size>
+class spscRing {
+  static_assert(size > 0 && size <= 128 && (size & (size - 1)) == 0, "ring size must be a power of 2, up to 128");
+
+private:
+  T items[size];
+  volatile byte head = 0; // next slot to write, only changed by the producer
+  volatile byte tail = 0; // next slot to read, only changed by the consumer
+
+public:
+  // producer: add an item
+  // returns false (and drops it) if the ring is full
+  bool push(const T &item) {
+    byte h = head;
+    if ((byte)(h - tail) == size)
+      return false;
+
+    items[h & (size - 1)] = item;
+    SPSC_BARRIER();
+    head = h + 1;
+    return true;
+  }
+
+  // consumer: copy the oldest item without removing it
+  // returns false if the ring is empty
+  bool peek(T &item) {
+    byte t = tail;
+    if (t == head)
+      return false;
+
+    SPSC_BARRIER();
+    item = items[t & (size - 1)];
+    return true;
+  }
+
+  // consumer: remove the oldest item (after a successful peek)
+  void pop() {
+    SPSC_BARRIER();
+    tail = tail + 1;
+  }
+
+  // consumer: remove everything
+  void flush() {
+    tail = head;
+  }
+
+  bool empty() {
+    return tail == head;
+  }
+};
@@ -0,0 +1,104 @@
+#include "taskScheduler.h"
+
+void taskScheduler::resetStats() {
+  for (byte i = 0; i < numTasks; i++) {
+    tasks[i].runs = 0;
+    tasks[i].overruns = 0;
+    tasks[i].deferrals = 0;
+  }
+}
+
+unsigned long taskScheduler::totalOverruns() {
+  unsigned long total = 0;
+  for (byte i = 0; i < numTasks; i++)
+    total += tasks[i].overruns;
+  return total;
+}
+
+unsigned long taskScheduler::totalDeferrals() {
+  unsigned long total = 0;
+  for (byte i = 0; i < numTasks; i++)
+    total += tasks[i].deferrals;
+  return total;
+}
+
+// check whether running task t now would make a non-deferrable task late
+bool taskScheduler::wouldDelayOthers(const schedulerTask &t, unsigned long now) {
+  for (byte i = 0; i < numTasks; i++) {
+    schedulerTask &other = tasks[i];
+    if (&other == &t || other.deferrable)
+      continue;
+
+    // periodic tasks are only at risk if they become due before t would finish
+    // (a periodic task with a ready check isn't at risk between runs just because it always has something to do)
+    if (other.periodMicros != 0 && (long)(other.nextRunMicros - now) >= (long)t.costMicros)
+      continue;
+
+    if (other.ready) {
+      // event driven tasks are at risk whenever they have something to do
+      if (other.ready())
+        return true;
+    }
+    else if (other.periodMicros != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// run every task that's due once, in priority order
+void taskScheduler::runOnce() {
+  for (byte i = 0; i < numTasks; i++) {
+    schedulerTask &t = tasks[i];
+
+    if (pollHook)
+      pollHook();
+
+    unsigned long now = micros();
+
+    if (t.periodMicros != 0 && (long)(now - t.nextRunMicros) < 0)
+      continue; // not due yet
+
+    if (t.ready && !t.ready())
+      continue; // nothing to do
+
+    // how late the task is (0 for tasks that run every pass)
+    unsigned long lateMicros = (t.periodMicros != 0) ? now - t.nextRunMicros : 0;
+
+    if (t.deferrable && wouldDelayOthers(t, now)) {
+      // don't let deferrable tasks starve completely -- once they're a full period late, run anyway
+      // (or deferring for SCHEDULER_MAX_DEFER_MICROS, for event driven ones)
+      if (t.periodMicros == 0 && !t.deferring) {
+        t.deferring = true;
+        t.deferredSinceMicros = now;
+      }
+      unsigned long deferLimit = (t.periodMicros != 0) ? t.periodMicros : SCHEDULER_MAX_DEFER_MICROS;
+      unsigned long deferredMicros = (t.periodMicros != 0) ? lateMicros : now - t.deferredSinceMicros;
+      if (deferredMicros < deferLimit) {
+        t.deferrals++;
+        continue;
+      }
+    }
+    t.deferring = false;
+
+    t.run();
+
+    unsigned long runMicros = micros() - now;
+    t.runs++;
+
+    // track a slowly decaying maximum so one fast run doesn't hide the usual cost
+    t.costMicros -= t.costMicros / 16;
+    if (runMicros > t.costMicros)
+      t.costMicros = runMicros;
+
+    if (t.periodMicros != 0) {
+      if (lateMicros >= t.periodMicros || runMicros > t.periodMicros)
+        t.overruns++;
+
+      // schedule from the deadline to avoid drift, but skip missed slots instead of bursting to catch up
+      t.nextRunMicros += t.periodMicros;
+      if ((long)(now - t.nextRunMicros) >= 0)
+        t.nextRunMicros = now + t.periodMicros;
+    }
+  }
+}
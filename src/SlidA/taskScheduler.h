@@ -0,0 +1,73 @@
+/*
+ * tiny cooperative scheduler for the main loop
+ *
+ * tasks are given in priority order (first is highest) and each one is either:
+ *   - periodic: runs every periodMicros (0 means as often as possible)
+ *   - event driven: has a `ready` check, and only runs when that returns true
+ *
+ * deferrable tasks (LED refresh, status lights) are skipped when running them would
+ * make a non-deferrable task late, based on the longest recent run time of the task
+ *
+ * an optional poll hook is called before every task, for background work that needs
+ * servicing more often than once per pass (eg. stepping an I2C transfer)
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// event driven deferrable tasks run anyway once they've been deferring for this long since they last ran
+// (periodic ones run anyway once they're a full period late)
+#define SCHEDULER_MAX_DEFER_MICROS 10000
+
+struct schedulerTask {
+  // the task itself
+  void (*run)();
+
+  // run every X microseconds (0 = every pass)
+  unsigned long periodMicros;
+
+  // optional -- if set, the task only runs when this returns true
+  // when checking deferrals, a ready non-deferrable task counts as due right now,
+  // but one with a period is only checked once it would become due before the deferrable task finished
+  bool (*ready)();
+
+  // can be skipped to keep non-deferrable tasks on time
+  bool deferrable;
+
+  // scheduler state, leave these out when defining tasks (they start zeroed, so every task is due on the first pass)
+  unsigned long nextRunMicros;
+  unsigned long costMicros; // decaying maximum of recent run times
+  unsigned long runs;
+  unsigned long overruns; // times the task started a full period late or ran longer than its period
+  unsigned long deferrals; // times the task was skipped to protect another task
+  unsigned long deferredSinceMicros; // event driven tasks: first deferral since the task last ran
+  bool deferring; // event driven tasks: whether the task has been deferred since it last ran
+};
+
+class taskScheduler {
+private:
+  schedulerTask* tasks;
+  byte numTasks;
+  void (*pollHook)();
+
+  // check whether running task t now would make a non-deferrable task late
+  bool wouldDelayOthers(const schedulerTask &t, unsigned long now);
+
+public:
+  // pollFunc is optional, and is called before every task
+  taskScheduler(schedulerTask* taskList, byte taskCount, void (*pollFunc)() = NULL) {
+    tasks = taskList;
+    numTasks = taskCount;
+    pollHook = pollFunc;
+  }
+
+  // run every task that's due once, in priority order
+  void runOnce();
+
+  // reset run/overrun/deferral counts
+  void resetStats();
+
+  // overruns and deferrals of every task since the last resetStats()
+  unsigned long totalOverruns();
+  unsigned long totalDeferrals();
+};
@@ -0,0 +1,186 @@
+#include "twiAsync.h"
+#include "mprRegs.h"
+
+#ifdef TWCR
+  #include <util/twi.h>
+#endif
+
+// transfer states
+enum twiAsyncState : byte {
+  TWI_ASYNC_IDLE,
+  TWI_ASYNC_START, // waiting for START
+  TWI_ASYNC_SLA_W, // waiting for address+W ack
+  TWI_ASYNC_REG, // waiting for register ack
+  TWI_ASYNC_RESTART, // waiting for repeated START
+  TWI_ASYNC_SLA_R, // waiting for address+R ack
+  TWI_ASYNC_DATA, // receiving data
+};
+
+// queue a read of len registers starting at reg into buf
+// buf must stay valid until the batch finishes
+// returns false if the queue is full
+bool twiAsync::queueRead(byte address, byte reg, byte* buf, byte len) {
+  // start a new batch once the last one is done
+  if (idle() && jobCount > 0) {
+    jobCount = 0;
+    jobPos = 0;
+    failedMask = 0;
+    skippedMask = 0;
+    stopCount = 0;
+  }
+
+  if (jobCount >= TWI_ASYNC_MAX_JOBS || len == 0)
+    return false;
+
+  readJob &job = jobs[jobCount++];
+  job.address = address;
+  job.reg = reg;
+  job.buf = buf;
+  job.len = len;
+  return true;
+}
+
+// end the current job (sending STOP on hardware) and move to the next one
+void twiAsync::endJob(bool ok) {
+  #ifdef TWCR
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+  #endif
+
+  if (ok) {
+    completedReads++;
+  }
+  else {
+    failedMask |= 1 << jobPos;
+    failedReads++;
+  }
+
+  jobPos++;
+  if (jobPos < stopCount && stopCheck()) {
+    while (jobPos < stopCount)
+      skippedMask |= 1 << jobPos++;
+  }
+  dataPos = 0;
+  state = TWI_ASYNC_IDLE;
+  stepped();
+}
+
+#ifdef TWCR
+
+// advance the current transfer if the bus is ready
+void twiAsync::poll() {
+  if (idle())
+    return;
+
+  if (state == TWI_ASYNC_IDLE) {
+    // wait for the last STOP to go out before starting again
+    if (TWCR & _BV(TWSTO))
+      return;
+
+    state = TWI_ASYNC_START;
+    stepped();
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTA); // no TWIE -- Wire's ISR must not see this
+    return;
+  }
+
+  if (!(TWCR & _BV(TWINT))) {
+    // still busy -- the timeout runs from the last bus step, so a long batch that's still moving never hits it
+    if (++busyPolls < TWI_ASYNC_CLOCK_CHECK_POLLS)
+      return;
+    busyPolls = 0;
+
+    unsigned long now = micros();
+    if (!stepTimed) {
+      stepMicros = now;
+      stepTimed = true;
+    }
+    else if (now - stepMicros > TWI_ASYNC_TIMEOUT_US) {
+      // bus is stuck, reset the TWI and give up on this read
+      TWCR = 0;
+      TWCR = _BV(TWEN);
+      endJob(false);
+    }
+    return;
+  }
+
+  stepped();
+
+  readJob &job = jobs[jobPos];
+  byte status = TW_STATUS;
+
+  switch (state) {
+    case TWI_ASYNC_START:
+      if (status != TW_START && status != TW_REP_START)
+        return endJob(false);
+      TWDR = (job.address << 1) | TW_WRITE;
+      TWCR = _BV(TWINT) | _BV(TWEN);
+      state = TWI_ASYNC_SLA_W;
+      break;
+
+    case TWI_ASYNC_SLA_W:
+      if (status != TW_MT_SLA_ACK)
+        return endJob(false);
+      TWDR = job.reg;
+      TWCR = _BV(TWINT) | _BV(TWEN);
+      state = TWI_ASYNC_REG;
+      break;
+
+    case TWI_ASYNC_REG:
+      if (status != TW_MT_DATA_ACK)
+        return endJob(false);
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTA); // repeated start, the MPR121 needs it to keep the register pointer
+      state = TWI_ASYNC_RESTART;
+      break;
+
+    case TWI_ASYNC_RESTART:
+      if (status != TW_REP_START)
+        return endJob(false);
+      TWDR = (job.address << 1) | TW_READ;
+      TWCR = _BV(TWINT) | _BV(TWEN);
+      state = TWI_ASYNC_SLA_R;
+      break;
+
+    case TWI_ASYNC_SLA_R:
+      if (status != TW_MR_SLA_ACK)
+        return endJob(false);
+      // ACK every byte but the last
+      TWCR = _BV(TWINT) | _BV(TWEN) | (job.len > 1 ? _BV(TWEA) : 0);
+      state = TWI_ASYNC_DATA;
+      break;
+
+    case TWI_ASYNC_DATA:
+      if (status != TW_MR_DATA_ACK && status != TW_MR_DATA_NACK)
+        return endJob(false);
+
+      job.buf[dataPos++] = TWDR;
+
+      if (dataPos == job.len)
+        return endJob(true);
+
+      TWCR = _BV(TWINT) | _BV(TWEN) | (dataPos < job.len - 1 ? _BV(TWEA) : 0);
+      break;
+
+    default:
+      endJob(false);
+      break;
+  }
+}
+
+#else // TWCR
+
+// advance the current transfer if the bus is ready
+// (no TWI hardware, so just do the next read in one go)
+void twiAsync::poll() {
+  if (idle())
+    return;
+
+  readJob &job = jobs[jobPos];
+  endJob(mprReadRegisters(job.address, job.reg, job.buf, job.len));
+}
+
+#endif // TWCR
+
+// poll until idle (use before touching Wire)
+void twiAsync::finish() {
+  while (!idle())
+    poll();
+}
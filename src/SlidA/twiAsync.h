@@ -0,0 +1,94 @@
+/*
+ * background I2C register reads, so the CPU isn't stuck waiting on the bus during scans
+ *
+ * reads are queued as a batch and the TWI hardware is stepped through each transfer
+ * (START, address, register, repeated START, address, data..., STOP) whenever poll() is called
+ *
+ * Wire's twi.c is always linked in (QuickMpr121 uses it) and owns TWI_vect, so this can't use its own ISR.
+ * instead the TWI runs with its interrupt disabled and poll() advances one bus step each time TWINT is set,
+ * which is a couple of register reads when the bus is still busy. the scheduler calls poll() between every task.
+ * Wire must not be used while a batch is running -- call finish() first.
+ *
+ * so the bus only moves on when something calls poll(): a read in flight stalls for as long as the task that's running.
+ * LED updates and blocking keepalive scans hold reads up by about their own length (~1ms), and calibrateMprs blocks for
+ * ~8s (it finishes any batch before it starts, through setScanning, so no read is left waiting that long)
+ *
+ * without AVR TWI registers (eg. host builds), poll() just runs one read per call through Wire
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// maximum number of reads in one batch
+#define TWI_ASYNC_MAX_JOBS 8
+
+// give up on a read if the bus has made no progress for this long (eg. bus stuck), and reset the TWI
+#define TWI_ASYNC_TIMEOUT_US 5000
+
+// only look at the clock for the timeout after this many polls in a row with the bus busy
+// (micros() takes a few us on AVR, and poll() runs on every soft bus clock edge, so most bus steps never need it)
+#define TWI_ASYNC_CLOCK_CHECK_POLLS 16
+
+class twiAsync {
+private:
+  struct readJob {
+    byte address;
+    byte reg;
+    byte* buf;
+    byte len;
+  };
+
+  readJob jobs[TWI_ASYNC_MAX_JOBS];
+  byte jobCount = 0;
+  byte jobPos = 0; // job being transferred (== jobCount when the batch is done)
+  byte dataPos = 0; // bytes of the current job received so far
+  byte state = 0;
+  byte failedMask = 0; // bit set for each job in the batch that failed
+  byte skippedMask = 0; // bit set for each job in the batch skipped by stopCheck
+  byte stopCount = 0; // jobs before this can be skipped by stopCheck
+  bool (*stopCheck)() = NULL;
+  byte busyPolls = 0; // polls since the last bus step or clock check
+  bool stepTimed = false; // whether stepMicros has been set for the current bus step
+  unsigned long stepMicros; // roughly when the current bus step started (the first clock check after it)
+
+  // note that the bus moved on, so the timeout starts again
+  void stepped() {
+    busyPolls = 0;
+    stepTimed = false;
+  }
+
+  // end the current job (sending STOP on hardware) and move to the next one
+  void endJob(bool ok);
+
+public:
+  // queue a read of len registers starting at reg into buf
+  // buf must stay valid until the batch finishes
+  // returns false if the queue is full
+  bool queueRead(byte address, byte reg, byte* buf, byte len);
+
+  // advance the current transfer if the bus is ready
+  void poll();
+
+  // whether every queued read has finished (successfully or not)
+  bool idle() { return jobPos == jobCount; }
+
+  // poll until idle (use before touching Wire)
+  void finish();
+
+  // which reads in the last batch failed (bit n = nth queued read)
+  byte getFailedMask() { return failedMask; }
+
+  // after each of the batch's first count reads, skip the rest of those reads if check returns true
+  // (eg. once an IRQ line is released). call after queueing the batch, it's cleared when the next one starts
+  void setStopCheck(byte count, bool (*check)()) {
+    stopCount = count;
+    stopCheck = check;
+  }
+
+  // which reads in the last batch were skipped by the stop check (bit n = nth queued read)
+  byte getSkippedMask() { return skippedMask; }
+
+  // reads completed/failed since boot
+  unsigned long completedReads = 0;
+  unsigned long failedReads = 0;
+};